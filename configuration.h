@@ -1,18 +1,213 @@
     /* 
-       If your computer has 16GiB of RAM available to use, set this to 1. The 
-       typical speedup with it enabled is about 1.75x, but set it 0 if space is 
-       unavailable. That said, there is a small overhead cost of allocating
-       the memory of ~0.5s. 
+      The visited set is picked at run time for every solve (see 
+      chooseBackend in msSolver.cpp): the bitmap (16GiB for French boards)
+      is only used when it fits in MEMORY_BUDGET_PERCENT of the memory this
+      process can use, counting cgroup limits, and the start board is big 
+      enough to need it. msSolver::setBackend (or msGame's --backend flag)
+      overrides the choice. With LOG_BACKEND_CHOICE at 1 every change of 
+      choice is logged to std::clog - it is off by default so msGame's 
+      output stays clean, and msBench prints each solve's backend anyway
     */
-    #define HAVE_16GB_RAM 0
+    #ifndef MEMORY_BUDGET_PERCENT
+        #define MEMORY_BUDGET_PERCENT 75
+    #endif
+    #ifndef LOG_BACKEND_CHOICE
+        #define LOG_BACKEND_CHOICE 0
+    #endif
 
 
     /* 
-      The _pext_u64 instruction only exists on intel's x86 architecture - 
-      it enables about a 15% speedup when available
+      The _pext_u64 instruction only exists on x86 (BMI2). With HAVE_PEXT 
+      at 1, getCanonicalBits and boardToBits are also compiled for BMI2 cpus
+      and the faster version is picked at run time (see msCpu.h), whatever 
+      -march the build used. Set it to 0 to never use pext
     */
-    #ifdef __BMI2__
-        #define HAVE_PEXT 1
+    #ifndef HAVE_PEXT
+        #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+            #define HAVE_PEXT 1
+        #else
+            #define HAVE_PEXT 0
+        #endif
+    #endif
+
+    /* 
+      With HAVE_SIMD_DISPATCH at 1, msBoard::canonicalKeys (the batch 
+      canonicalization) is also compiled for AVX2 and AVX-512, and the 
+      widest the cpu has is picked at run time (see msCpu.h). At 0 it 
+      always uses 128 bit vectors (SSE2 / NEON)
+    */
+    #ifndef HAVE_SIMD_DISPATCH
+        #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+            #define HAVE_SIMD_DISPATCH 1
+        #else
+            #define HAVE_SIMD_DISPATCH 0
+        #endif
+    #endif
+
+    /* 
+      Without pext, gather a board's columns with a mask, one multiply and
+      a shift instead of one shift-and-mask per row (see COL_MAGICS in 
+      msBoard.cpp). Only affects 64 bit boards on cpus without a fast pext
+    */
+    #ifndef ENABLE_MAGIC_COLUMNS
+        #define ENABLE_MAGIC_COLUMNS 1
+    #endif
+
+    /* 
+      Build the 8 symmetric images of a board (getCanonicalBits and 
+      transformBoard) in a padded 8x8 layout, where the flips are a byte 
+      swap, a per-byte bit reverse and a bit-matrix transpose (see 
+      PADDED_OK in msBoard.cpp). Only affects boards of up to 8x8
+    */
+    #ifndef ENABLE_PADDED_SYMMETRIES
+        #define ENABLE_PADDED_SYMMETRIES 1
+    #endif
+
+    /* 
+      Set to 1 to have getCanonicalBits build the images a row at a time 
+      and drop each as soon as it is known not to be the smallest (see 
+      getCanonicalBitsLazy). Same results, but about twice as slow as the 
+      padded build of all 8 images - see README
+    */
+    #ifndef ENABLE_LAZY_CANONICAL
+        #define ENABLE_LAZY_CANONICAL 0
+    #endif
+
+    /* 
+      rdtsc gives us a cheap cycle counter on x86 - used by the benchmarks and
+      profiling counters. Other architectures fall back to nanoseconds
+    */
+    #if defined(__x86_64__) || defined(__i386__)
+        #define HAVE_RDTSC 1
     #else
-        #define HAVE_PEXT 0
-    #endif 
\ No newline at end of file
+        #define HAVE_RDTSC 0
+    #endif
+
+
+
+    /* 
+      Set to 1 to have msSolver::solve fill in the per-node counters of
+      SolverStats (nodes, visited-set hits per depth, branching, cycles per
+      phase). With it at 0 the counters are compiled out entirely
+    */
+    #ifndef COLLECT_SOLVER_STATS
+        #define COLLECT_SOLVER_STATS 0
+    #endif
+
+
+    /* 
+      Set to 1 to accumulate rdtsc cycle counts for each phase of the solver's
+      hot loop (applyMove, getCanonicalBits, testAndSet, validMoves and stack 
+      push / pop) and print a breakdown to stderr when the program exits. 
+      See msTrace.h. At 0 the tracing compiles out completely
+    */
+    #ifndef ENABLE_PHASE_TRACE
+        #define ENABLE_PHASE_TRACE 0
+    #endif
+
+
+    /* 
+      Set to 1 to have the solver skip moves that only reorder independent
+      moves it has already tried (a sleep-set partial-order reduction - see
+      runDFS in msSolver.cpp). It never changes whether a board is solvable,
+      and cuts the number of visited-set probes
+    */
+    #ifndef ENABLE_SLEEP_SETS
+        #define ENABLE_SLEEP_SETS 1
+    #endif
+
+
+    /* 
+      Set to 1 to have the solver play only one move out of each set of 
+      moves that a symmetry of the current board maps onto each other - they
+      all lead to the same canonical board. Like ENABLE_SLEEP_SETS it never 
+      changes whether a board is solvable
+    */
+    #ifndef ENABLE_STABILIZER_PRUNING
+        #define ENABLE_STABILIZER_PRUNING 1
+    #endif
+
+
+    /* 
+      Set to 1 to have the solver drop every board with 2 or more dead 
+      marbles - marbles that can never move or be jumped again (see 
+      msBasicBoard::numDeadMarbles). Only unwinnable boards are dropped
+    */
+    #ifndef ENABLE_DEAD_MARBLE_PRUNING
+        #define ENABLE_DEAD_MARBLE_PRUNING 1
+    #endif
+
+
+    /* 
+      Set to 1 to have the solver prefetch the visited-set entries of all of
+      a board's children in one batch (msBitmap::prefetchBatch) as soon as
+      the board is reached, so that the cache misses of testing them overlap
+      (see expandChildren in msSolver.cpp).
+      Only a cache hint - the search itself is the same either way
+    */
+    #ifndef ENABLE_CHILD_PREFETCH
+        #define ENABLE_CHILD_PREFETCH 1
+    #endif
+
+    /* 
+      Set to 1 to have the solver look all of a board's children up in the
+      visited set in one batch (msBitmap::testBatch) as soon as the board is
+      reached, instead of only prefetching them. Children found there skip 
+      their testAndSet - the rest are still added one at a time, when the 
+      search reaches them, so the search itself is the same either way.
+      Off by default: the new children are then looked up twice, and the 
+      French default solve was measured about 15% slower
+    */
+    #ifndef ENABLE_BATCHED_PROBES
+        #define ENABLE_BATCHED_PROBES 0
+    #endif
+
+
+    /* 
+      The visited set keeps a direct-mapped cache of the 2^RECENT_FILTER_LOG2
+      most recently tested boards in front of its backend (see 
+      msRecentFilter.h). A board found there is a hit without touching the
+      backend. 0 turns the filter off
+    */
+    #ifndef RECENT_FILTER_LOG2
+        #define RECENT_FILTER_LOG2 0
+    #endif
+
+
+    /* 
+      Set to 1 to have the solver drop every board where an empty Merson 
+      region (one no marble can ever enter again) leaves marbles in two parts
+      of the board that can never meet (see 
+      msBasicBoard::isSplitByMersonRegion). Off by default: the smallest
+      Merson regions of the bundled shapes hold 21+ positions, so they are 
+      rarely empty while the marbles are still split, and dead-marble 
+      pruning already catches most of those boards
+    */
+    #ifndef ENABLE_MERSON_PRUNING
+        #define ENABLE_MERSON_PRUNING 0
+    #endif
+
+
+    /* 
+      Which boards are canonicalized and put in the visited set, by marble
+      count (see MemoPolicy in msSolver.cpp). Boards with fewer than 
+      MEMO_MIN_MARBLES marbles are searched again every time they are 
+      reached - their subtrees are cheaper than a visited-set probe. 
+      With ADAPTIVE_MEMO at 1 the solver raises that bound one marble at a 
+      time while it runs: once MEMO_WARMUP_PROBES boards with the next marble
+      count have been probed, it stops memoizing them if 
+          hits * (1 + children per new board) < MEMO_MIN_BENEFIT% of probes
+      i.e. if the work a hit saves is smaller than the probes spent on them
+    */
+    #ifndef MEMO_MIN_MARBLES
+        #define MEMO_MIN_MARBLES 3
+    #endif
+    #ifndef ADAPTIVE_MEMO
+        #define ADAPTIVE_MEMO 1
+    #endif
+    #ifndef MEMO_WARMUP_PROBES
+        #define MEMO_WARMUP_PROBES 64
+    #endif
+    #ifndef MEMO_MIN_BENEFIT
+        #define MEMO_MIN_BENEFIT 90
+    #endif
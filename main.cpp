@@ -7,10 +7,16 @@
     starting empty position and then play the game by entering moves in the
     terminal. Input is taken in through stdin and all output goes to stdout.
     Please be patient when requesting hints because sometimes it takes a minute.
+    Entering "stats" solves the current board and prints the solver statistics.
+
+    Usage: ./msGame [--backend=auto|bitmap|quotient|hash]
+        --backend forces the solver's visited set - by default it is picked
+        for every solve from the memory available (see configuration.h)
 
 */
 
 #include "msGame.h"
+#include "msSolver.h"
 
 #include <iostream>
 #include <sstream>
@@ -33,15 +39,26 @@ Parameters:
     char *argv[] - a pointer to an array of characters holding the actual 
                    things typed in the command line
 Returns: 
-    an int - should return 0 (EXIT_SUCCESS)
+    an int - should return 0 (EXIT_SUCCESS), or 1 (EXIT_FAILURE) if the
+             arguments are invalid
 Expects: 
-    argc should be 1 (just the program name)
+    argc should be 1 (just the program name), or 2 with a --backend flag
 Notes:
     Controls all I/O
 ****************************************/
 int main (int argc, char *argv[]) {
-    (void) argc;
-    (void) argv;
+    const std::string BACKEND_FLAG = "--backend=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        msSolver::Backend backend;
+        if (arg.compare(0, BACKEND_FLAG.size(), BACKEND_FLAG) != 0 ||
+            !msSolver::parseBackend(argv[i] + BACKEND_FLAG.size(), backend)) {
+            std::cerr << "usage: " << argv[0] 
+                      << " [--backend=auto|bitmap|quotient|hash]\n";
+            return 1;
+        }
+        msSolver::setBackend(backend);
+    }
 
     clearScreen();
 
@@ -101,6 +118,8 @@ void playGame(msGame &game)
                       << ((game.getBestMove() == "") 
                             ? "No solution for this board. Try undoing!" 
                             : (game.getBestMove())) << std::endl;
+        } else if (input == "stats") {
+            game.getSolverStats(std::cout);
         } else if (input == "undo") {
             if (marblesLeft == INIT_MARBLE_CT) {
                 std::cout << "No moves to undo!" << std::endl;
@@ -0,0 +1,566 @@
+/*
+    msBench.cpp
+    Marble Solitaire
+
+    Microbenchmarks for the hot board primitives. A large set of reachable
+    boards is generated by random playouts from every single-hole start, and
+    then each kernel is run over the whole set and timed in isolation. For
+    each kernel we report ns/op, millions of ops per second and cycles/op
+    (rdtsc ticks - see msCycles.h for non-x86 hosts).
+
+    Usage: ./msBench [numBoards]
+        numBoards defaults to 2^20. The bitmap backend maps 16GiB of virtual
+        memory but only touches the pages that the boards land on.
+
+    Each visited set is timed both one board at a time and in batches that
+    are all prefetched before any of them is tested. The sharded
+    set is also timed with several threads adding boards at once, up to one
+    per core.
+
+    Any change to msBoard or msBitmap should be measured with this before and
+    after, rather than only through end-to-end solve times. Before timing
+    anything, the faster kernels are checked against the plain ones on the
+    first SELF_CHECK_BOARDS boards (getCanonicalBitsLazy and canonicalKeys
+    against getCanonicalBits, validUndoMoves against validMoves), and msBench exits with EXIT_FAILURE on the first
+    board they disagree on.
+
+    The header line says whether the board kernels picked their pext 
+    versions on this cpu (see msCpu.h).
+
+    The last section solves a few fixed boards end to end and reports the 
+    visited-set traffic - the number of testAndSet probes needs 
+    COLLECT_SOLVER_STATS, and search changes like ENABLE_SLEEP_SETS can be 
+    compared by building with each setting (e.g. -DENABLE_SLEEP_SETS=0).
+*/
+
+#include "msBoard.h"
+#include "msBitmap.h"
+#include "msCpu.h"
+#include "msCycles.h"
+#include "msSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    /******************************* Constants: *******************************/
+    constexpr size_t   DEFAULT_NUM_BOARDS = 1 << 20;
+    constexpr uint64_t BITMAP_BITS        = 1ULL << 37;
+    constexpr unsigned RNG_SEED           = 411;
+    constexpr int      NUM_TRANSFORMS     = 8;
+    // about the number of children the solver tests together
+    constexpr size_t   PROBE_BATCH        = 16;
+    // how many of the workload's boards the self-checks look at
+    constexpr size_t   SELF_CHECK_BOARDS  = 1 << 14;
+
+    const int BOARD_ROWS = 7;
+    const int BOARD_COLS = 7;
+
+    using BitmapSeen = msBitmap<msBoard, decltype(&msBoard::boardToBits),
+                                BITMAP_BACKEND>;
+    using HashSeen   = msBitmap<msBoard, decltype(&msBoard::boardToBits),
+                                HASH_SET_BACKEND>;
+    using QuotientSeen = msBitmap<msBoard, decltype(&msBoard::boardToBits),
+                                  QUOTIENT_BACKEND>;
+    using ShardedSeen  = msBitmap<msBoard, decltype(&msBoard::boardToBits),
+                                  SHARDED_BACKEND>;
+
+    /************ Workload *********
+     Everything the kernels are run over - built once, before any timing
+
+    Members:
+        std::vector<msBoard> boards         - random reachable boards
+        std::vector<msBoard> moveBoards     - the boards that have a legal move
+        std::vector<msBoard::Move> moves    - one legal move per moveBoard
+        std::vector<msBoard::Transform> transforms - a random transform to
+                                                     pair with each move
+    *********************************/
+    struct Workload {
+        std::vector<msBoard> boards;
+        std::vector<msBoard> moveBoards;
+        std::vector<msBoard::Move> moves;
+        std::vector<msBoard::Transform> transforms;
+    };
+
+    /* Keeps the compiler from throwing away the work being timed */
+    volatile uint64_t sink;
+
+
+    /************************* Function declarations: *************************/
+    Workload buildWorkload(size_t numBoards);
+    bool checkLazyCanonical(const std::vector<msBoard> &boards);
+    bool checkCanonicalKeys(const std::vector<msBoard> &boards);
+    bool checkUndoMoves(const std::vector<msBoard> &boards);
+    template <typename Fn>
+    void runKernel(const std::string &name, size_t ops, Fn kernel, 
+                   bool warmUp = true);
+    template <typename Shape>
+    void runSolve(const std::string &name, const msBasicBoard<Shape> &board);
+    template <typename Seen>
+    void runTestAndSet(const std::string &name, 
+                       const std::vector<msBoard> &boards);
+    void runSharded(const std::vector<msBoard> &boards);
+
+
+    /******************************* Functions: *******************************/
+
+    /************ buildWorkload *********
+     Generates numBoards reachable boards by playing a random number of random
+     legal moves from a random single-hole start
+
+    Parameters:
+        size_t numBoards - the number of boards to generate
+    Returns:
+        A Workload holding the boards and a legal move for each board that
+        still has one
+    Notes:
+        Uses a fixed seed so runs are comparable with each other
+    *********************************/
+    Workload buildWorkload(size_t numBoards)
+    {
+        Workload w;
+        std::mt19937_64 rng(RNG_SEED);
+        msBoard::MoveList legal;
+
+        w.boards.reserve(numBoards);
+        while (w.boards.size() < numBoards) {
+            msBoard b(rng() % BOARD_ROWS, rng() % BOARD_COLS);
+            unsigned depth = rng() % 36;
+
+            for (unsigned i = 0; i < depth; i++) {
+                b.validMoves(legal);
+                if (legal.empty()) break;
+                b = b.applyMove(legal[rng() % legal.size()]);
+            }
+            b.validMoves(legal);
+            if (!legal.empty()) {
+                w.moveBoards.push_back(b);
+                w.moves.push_back(legal[rng() % legal.size()]);
+                w.transforms.push_back(
+                            msBoard::Transform(rng() % NUM_TRANSFORMS));
+            }
+            w.boards.push_back(b);
+        }
+        return w;
+    }
+
+    /************ checkLazyCanonical *********
+     Checks that getCanonicalBitsLazy agrees with getCanonicalBits on the 
+     first SELF_CHECK_BOARDS boards
+
+    Parameters:
+        const std::vector<msBoard> &boards - the boards to check
+    Returns:
+        A bool - true if every board gets the same canonical board, transform
+        and stabilizer from both, false (after printing the first mismatch 
+        to std::cerr) otherwise
+    *********************************/
+    bool checkLazyCanonical(const std::vector<msBoard> &boards)
+    {
+        size_t n = std::min(SELF_CHECK_BOARDS, boards.size());
+        for (size_t i = 0; i < n; i++) {
+            uint8_t stabilizer = 0, lazyStabilizer = 0;
+            auto [canonical, transform] = 
+                boards[i].getCanonicalBits(&stabilizer);
+            auto [lazy, lazyTransform] = 
+                boards[i].getCanonicalBitsLazy(&lazyStabilizer);
+
+            if (lazy.boardToBits() != canonical.boardToBits() ||
+                lazyTransform != transform || 
+                lazyStabilizer != stabilizer) {
+                std::cerr << "self-check failed: getCanonicalBitsLazy "
+                          << "disagrees with getCanonicalBits on board " 
+                          << i << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /************ checkCanonicalKeys *********
+     Checks that the batch canonicalKeys agrees with getCanonicalBits on the
+     first SELF_CHECK_BOARDS boards
+
+    Parameters:
+        const std::vector<msBoard> &boards - the boards to check
+    Returns:
+        A bool - true if every board gets the key of its canonical board and
+        the same transform from both, false (after printing the first 
+        mismatch to std::cerr) otherwise
+    *********************************/
+    bool checkCanonicalKeys(const std::vector<msBoard> &boards)
+    {
+        size_t n = std::min(SELF_CHECK_BOARDS, boards.size());
+        std::vector<uint64_t> keys(n);
+        std::vector<msBoard::Transform> transforms(n);
+        msBoard::canonicalKeys(boards.data(), n, keys.data(), 
+                               transforms.data());
+
+        for (size_t i = 0; i < n; i++) {
+            auto [canonical, transform] = boards[i].getCanonicalBits();
+            if (keys[i] != canonical.boardToBits() || 
+                transforms[i] != transform) {
+                std::cerr << "self-check failed: canonicalKeys disagrees "
+                          << "with getCanonicalBits on board " << i 
+                          << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /************ checkUndoMoves *********
+     Checks validUndoMoves against validMoves on the first SELF_CHECK_BOARDS
+     boards: every legal move from a board must be undoable back to it, and
+     every undo move of a board must lead to a board with a legal move back
+
+    Parameters:
+        const std::vector<msBoard> &boards - the boards to check
+    Returns:
+        A bool - true if every round trip comes back to the board it started
+        from, false (after printing the first failure to std::cerr) otherwise
+    *********************************/
+    bool checkUndoMoves(const std::vector<msBoard> &boards)
+    {
+        size_t n = std::min(SELF_CHECK_BOARDS, boards.size());
+        msBoard::MoveList moves, back;
+
+        for (size_t i = 0; i < n; i++) {
+            const msBoard &b = boards[i];
+            uint64_t bits = b.boardToBits();
+
+            b.validMoves(moves);
+            for (msBoard::Move m : moves) {
+                msBoard next = b.applyMove(m);
+                next.validUndoMoves(back);
+                if (std::none_of(back.begin(), back.end(), 
+                                 [&](msBoard::Move u) {
+                        return next.undoMove(u).boardToBits() == bits;
+                    })) {
+                    std::cerr << "self-check failed: validUndoMoves misses "
+                              << "move " << m.toString() << " on board " 
+                              << i << std::endl;
+                    return false;
+                }
+            }
+
+            b.validUndoMoves(moves);
+            for (msBoard::Move u : moves) {
+                msBoard prev = b.undoMove(u);
+                prev.validMoves(back);
+                if (std::none_of(back.begin(), back.end(), 
+                                 [&](msBoard::Move m) {
+                        return prev.applyMove(m).boardToBits() == bits;
+                    })) {
+                    std::cerr << "self-check failed: validUndoMoves gives "
+                              << "illegal move " << u.toString() 
+                              << " on board " << i << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /************ runKernel *********
+     Times a kernel and prints one line of results
+
+    Parameters:
+        const std::string &name - the name printed for this kernel
+        size_t ops              - how many operations one call of kernel does
+        Fn kernel               - a callable that performs all ops operations
+        bool warmUp             - whether to run kernel once untimed first
+    Returns: void
+    Notes:
+        Warming up fills the caches and branch predictors - kernels that
+        change state (like testAndSet) should not be warmed up, or the timed
+        run would only measure the already-seen path
+    *********************************/
+    template <typename Fn>
+    void runKernel(const std::string &name, size_t ops, Fn kernel, 
+                   bool warmUp)
+    {
+        if (warmUp) kernel();
+
+        auto t1 = std::chrono::steady_clock::now();
+        uint64_t c1 = readCycles();
+        kernel();
+        uint64_t c2 = readCycles();
+        auto t2 = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(t2 - t1).count();
+        std::cout << std::left  << std::setw(28) << name << std::right
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(10) << ns / ops << " ns/op"
+                  << std::setw(10) << ops * 1e3 / ns << " Mops/s"
+                  << std::setw(10) << double(c2 - c1) / ops << " cycles/op"
+                  << std::endl;
+    }
+
+    /************ runTestAndSet *********
+     Times testAndSet on a fresh visited set, once one board at a time and
+     once in batches of PROBE_BATCH, prefetching every board in a batch 
+     (msBitmap::prefetchBatch) before testing any of them
+
+    Parameters:
+        const std::string &name           - the name of the backend
+        const std::vector<msBoard> &boards - the boards to add
+    Returns: void
+    Notes:
+        The batches show how much of testAndSet's cost is cache misses that
+        prefetching could overlap - the solver prefetches each frame's 
+        children the same way
+    *********************************/
+    template <typename Seen>
+    void runTestAndSet(const std::string &name, 
+                       const std::vector<msBoard> &boards)
+    {
+        {
+            Seen seen(BITMAP_BITS, &msBoard::boardToBits);
+            runKernel("testAndSet (" + name + ")", boards.size(), [&] {
+                uint64_t acc = 0;
+                for (const msBoard &b : boards) {
+                    acc += seen.testAndSet(b);
+                }
+                sink = acc;
+            }, false);
+        }
+        {
+            Seen seen(BITMAP_BITS, &msBoard::boardToBits);
+            runKernel("  batched", boards.size(), [&] {
+                uint64_t acc = 0;
+                for (size_t i = 0; i < boards.size(); i += PROBE_BATCH) {
+                    size_t n = std::min(PROBE_BATCH, boards.size() - i);
+                    seen.prefetchBatch(&boards[i], n);
+                    for (size_t k = 0; k < n; k++) {
+                        acc += seen.testAndSet(boards[i + k]);
+                    }
+                }
+                sink = acc;
+            }, false);
+        }
+    }
+
+    /************ runSharded *********
+     Times the sharded set with 1, 2, 4... threads up to the number of 
+     cores, each adding its own slice of the boards to one shared set
+
+    Parameters:
+        const std::vector<msBoard> &boards - the boards to add
+    Returns: void
+    Notes:
+        ns/op is wall time over all the boards, so perfect scaling halves it
+        with each doubling of threads. Also prints how many testAndSet calls
+        found their shard locked by another thread
+    *********************************/
+    void runSharded(const std::vector<msBoard> &boards)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned threads = 1; ; threads = std::min(threads * 2, cores)) {
+            ShardedSeen seen(BITMAP_BITS, &msBoard::boardToBits);
+            runKernel("  " + std::to_string(threads) + " threads", 
+                      boards.size(), [&] {
+                std::vector<std::thread> workers;
+                for (unsigned t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t] {
+                        size_t begin = boards.size() * t / threads;
+                        size_t end = boards.size() * (t + 1) / threads;
+                        for (size_t i = begin; i < end; i++) {
+                            seen.testAndSet(boards[i]);
+                        }
+                    });
+                }
+                for (std::thread &w : workers) w.join();
+            }, false);
+            std::cout << "    " << seen.contention() << " contended, " 
+                      << seen.size() << " boards" << std::endl;
+            if (threads == cores) break;
+        }
+    }
+
+    /************ runSolve *********
+     Solves one board end to end and prints one line of results
+
+    Parameters:
+        const std::string &name         - the name printed for this board
+        const msBasicBoard<Shape> &board - the board to solve
+    Returns: void
+    Notes:
+        probes (calls to the visited set's testAndSet) is only counted when
+        COLLECT_SOLVER_STATS is 1
+    *********************************/
+    template <typename Shape>
+    void runSolve(const std::string &name, const msBasicBoard<Shape> &board)
+    {
+        msSolver::SolverStats stats;
+
+        auto t1 = std::chrono::steady_clock::now();
+        size_t moves = msSolver::solve(board, &stats).size();
+        auto t2 = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        std::cout << std::left  << std::setw(28) << name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(10) << ms << " ms"
+                  << std::setw(4) << moves << " moves"
+                  << std::setw(12) << stats.seenSize << " visited"
+                  << std::setw(10) << msSolver::backendName(stats.backend);
+        if constexpr (COLLECT_SOLVER_STATS) {
+            std::cout << std::setw(12) << stats.seenProbes << " probes"
+                      << std::setw(12) << stats.sleepSkips << " slept"
+                      << std::setw(8) << stats.symmetricNodes << " symmetric";
+        }
+        std::cout << std::endl;
+    }
+}
+
+
+/************ main *********
+ Builds the workload and runs every kernel over it
+
+Parameters:
+    int argc     - the number of arguments in the command line
+    char *argv[] - optionally holds the number of boards to generate
+Returns:
+    an int - EXIT_SUCCESS, or EXIT_FAILURE if a self-check fails
+Notes:
+    The self-checks run before any timing, so a kernel that gives wrong
+    answers stops the run instead of being benchmarked
+****************************************/
+int main(int argc, char *argv[])
+{
+    size_t numBoards = (argc > 1) ? std::strtoull(argv[1], nullptr, 10)
+                                  : DEFAULT_NUM_BOARDS;
+    Workload w = buildWorkload(numBoards);
+    const std::vector<msBoard> &boards = w.boards;
+    msBoard::MoveList moveBuffer;
+
+    std::cout << boards.size() << " boards, " << w.moves.size()
+              << " with legal moves, pext "
+              << (msCpu::features().fastPext ? "on" : "off")
+              << std::endl << std::endl;
+
+    if (!checkLazyCanonical(boards) || !checkCanonicalKeys(boards) ||
+        !checkUndoMoves(boards)) {
+        return EXIT_FAILURE;
+    }
+
+    runKernel("getCanonicalBits", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            auto [canonical, transform] = b.getCanonicalBits();
+            acc += canonical.boardToBits() + transform;
+        }
+        sink = acc;
+    });
+
+    uint64_t rowsCompared = 0;
+    runKernel("getCanonicalBitsLazy", boards.size(), [&] {
+        uint64_t acc = 0;
+        rowsCompared = 0;
+        for (const msBoard &b : boards) {
+            int rows = 0;
+            auto [canonical, transform] = b.getCanonicalBitsLazy(nullptr, 
+                                                                 &rows);
+            acc += canonical.boardToBits() + transform;
+            rowsCompared += rows;
+        }
+        sink = acc;
+    });
+    std::cout << "    " << std::setprecision(2) 
+              << double(rowsCompared) / boards.size() 
+              << " rows compared per board on average" << std::endl;
+
+    std::vector<uint64_t> keys(boards.size());
+    std::vector<msBoard::Transform> transforms(boards.size());
+    runKernel("canonicalKeys (batch)", boards.size(), [&] {
+        msBoard::canonicalKeys(boards.data(), boards.size(), keys.data(),
+                               transforms.data());
+        sink = keys.back() + transforms.back();
+    });
+
+    runKernel("validMoves", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            b.validMoves(moveBuffer);
+            acc += moveBuffer.size();
+        }
+        sink = acc;
+    });
+
+    runKernel("validUndoMoves", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            b.validUndoMoves(moveBuffer);
+            acc += moveBuffer.size();
+        }
+        sink = acc;
+    });
+
+    runKernel("applyMove", w.moves.size(), [&] {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < w.moves.size(); i++) {
+            acc += w.moveBoards[i].applyMove(w.moves[i]).boardToBits();
+        }
+        sink = acc;
+    });
+
+    runKernel("numDeadMarbles", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            acc += b.numDeadMarbles();
+        }
+        sink = acc;
+    });
+
+    runKernel("isSplitByMersonRegion", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            acc += b.isSplitByMersonRegion();
+        }
+        sink = acc;
+    });
+
+    runKernel("boardToBits", boards.size(), [&] {
+        uint64_t acc = 0;
+        for (const msBoard &b : boards) {
+            acc += b.boardToBits();
+        }
+        sink = acc;
+    });
+
+    runKernel("undoTransform", w.moves.size(), [&] {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < w.moves.size(); i++) {
+            msBoard::Move m = w.moves[i];
+            w.moveBoards[i].undoTransform(m, w.transforms[i]);
+            acc += w.moveBoards[i].applyMove(m).boardToBits();
+        }
+        sink = acc;
+    });
+
+    runTestAndSet<HashSeen>("hash set", boards);
+    runTestAndSet<QuotientSeen>("quotient set", boards);
+    runTestAndSet<BitmapSeen>("bitmap", boards);
+    runTestAndSet<ShardedSeen>("sharded set", boards);
+    runSharded(boards);
+
+    std::cout << std::endl << "solves (sleep sets " 
+              << (ENABLE_SLEEP_SETS ? "on" : "off") << ", stabilizer pruning "
+              << (ENABLE_STABILIZER_PRUNING ? "on" : "off") << ")" 
+              << std::endl;
+    runSolve("French (0, 2)", msBoard());
+    runSolve("English (3, 3)", msEnglishBoard());
+    runSolve("English (2, 3)", msEnglishBoard(2, 3));
+
+    return EXIT_SUCCESS;
+}
@@ -1,11 +1,11 @@
-
 /*
     msBitmap.h
     January 12th, 2026
     Brendan Roy
 
     Unified msBitmap that uses either a bitmap or a hash set, always requiring
-    an indexing function.
+    an indexing function. With RECENT_FILTER_LOG2 above 0, an msRecentFilter
+    sits in front of whichever one is used.
 */
 
 #ifndef MSBITMAP_H_
@@ -13,13 +13,45 @@
 
 #include <cstdint>
 #include <cassert>
+#include <cstring>
+#include <type_traits>
 #include <sys/mman.h>
+#include "configuration.h"
+#include "msQuotientSet.h"
+#include "msRecentFilter.h"
+#include "msShardedSet.h"
 #include "robin_hood.h"
 
 
 const static int INIT_SEEN_SIZE = 8000000;
+const static int INIT_QUOTIENT_LOG2 = 23;
+const static int SHARD_LOG2 = 6;
+
+/*
+    The ways an msBitmap can store its bits - a flat bitmap with one bit
+    per possible index (needs 16GiB for 37 bit indices), a hash set that
+    only stores the indices that were actually set, or an msQuotientSet,
+    which stores the same indices in 4 bytes a slot instead of 8. 
+    SHARDED_BACKEND is msQuotientSets split over 2^SHARD_LOG2 locked shards,
+    the only one several threads may call testAndSet on at once
+*/
+enum msBackend { BITMAP_BACKEND, HASH_SET_BACKEND, QUOTIENT_BACKEND,
+                 SHARDED_BACKEND };
+
+// the solver picks a backend at run time - this is only the template default
+constexpr msBackend DEFAULT_BACKEND = QUOTIENT_BACKEND;
+
+// the flat bitmap's storage - the other backends keep everything in their set
+struct msBitmapWords {
+    uint64_t* words = nullptr;
+    uint64_t sizeBits = 0;
+    uint64_t numSet = 0;
+};
+
+// stands in for a member the chosen Backend has no use for
+struct msNoStorage {};
 
-template <typename T, typename IndexFn>
+template <typename T, typename IndexFn, msBackend Backend = DEFAULT_BACKEND>
 class msBitmap {
     static_assert(std::is_invocable_r_v<uint64_t, IndexFn, const T&>,
                   "IndexFn must take const T& and return uint64_t");
@@ -36,20 +68,8 @@ public:
     Returns: void
     *********************************/
     msBitmap(uint64_t numBits, IndexFn fn)
-        : toIndex(fn)
+        : toIndex(fn), store(makeStore(numBits)), recent(makeRecent())
     {
-        #if HAVE_16GB_RAM
-            sizeBits = numBits;
-            size_t words = (sizeBits + 63) / 64;
-            void* ptr = mmap(nullptr, words * 8, PROT_READ | PROT_WRITE,
-                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-            assert(ptr != MAP_FAILED);
-            std::memset(ptr, 0, words * 8);
-            bitmap = static_cast<uint64_t*>(ptr);
-        #else
-            (void) numBits;
-            set.reserve(INIT_SEEN_SIZE);
-        #endif
     }
 
     /************ msBitmap destructor *********
@@ -57,10 +77,10 @@ public:
     *********************************/
     ~msBitmap() 
     {
-        #if HAVE_16GB_RAM
-            size_t words = (sizeBits + 63) / 64;
-            munmap(bitmap, words * 8);
-        #endif
+        if constexpr (Backend == BITMAP_BACKEND) {
+            size_t words = (store.sizeBits + 63) / 64;
+            munmap(store.words, words * 8);
+        }
     }
 
     /************ clear *********
@@ -70,15 +90,24 @@ public:
     Returns: void
     Expects: 
     Notes: 
-        May take a second or so to execute this function
+        The bitmap's pages are handed back to the kernel, which maps them to
+        zeroes again on their next touch - so clearing only costs the pages 
+        that were used, and they stop counting against the process's memory.
+        Falls back to zeroing all 2^37 bits (a second or so) if that fails
     *********************************/
     void clear() 
     {
-        #if HAVE_16GB_RAM
-            std::memset(bitmap, 0, (sizeBits + 63) / 64 * 8);
-        #else
-            set.clear();
-        #endif
+        if constexpr (Backend == BITMAP_BACKEND) {
+            size_t bytes = (store.sizeBits + 63) / 64 * 8;
+            if (madvise(store.words, bytes, MADV_DONTNEED) != 0) {
+                std::memset(store.words, 0, bytes);
+            }
+            store.numSet = 0;
+        } else {
+            store.clear();
+        }
+        if constexpr (USE_RECENT) recent.clear();
+        numRecentHits = 0;
     }
 
     /************ testAndSetBit *********
@@ -93,31 +122,244 @@ public:
         (value.*toIndex)() index must be less than 2^37
     Notes:
         Will CRE if (value.*toIndex)() is >= 2^37
+        An index found in the recent filter is answered without looking at
+        the backend at all. The sharded backend skips the filter, which is 
+        not thread safe
     *********************************/
     bool testAndSet(const T& value) 
     {
         uint64_t idx = (value.*toIndex)();
-        #if HAVE_16GB_RAM
-            assert(idx < sizeBits);
-            uint64_t& word = bitmap[idx >> 6];
+        if constexpr (USE_RECENT) {
+            if (recent.testAndSet(idx)) {
+                numRecentHits++;
+                return true;
+            }
+        }
+        if constexpr (Backend == BITMAP_BACKEND) {
+            assert(idx < store.sizeBits);
+            uint64_t& word = store.words[idx >> 6];
             uint64_t mask = 1ULL << (idx & 63);
             bool hit = word & mask;
             word |= mask;
+            store.numSet += !hit;
             return hit;
-        #else
-            return !set.insert(idx).second;
-        #endif
+        } else if constexpr (Backend == HASH_SET_BACKEND) {
+            return !store.insert(idx).second;
+        } else {
+            return store.testAndSet(idx);
+        }
+    }
+
+    /************ contains *********
+     Tells whether the bit at the given value's index is set, without 
+     setting it
+
+    Parameters: 
+        const T &value - reference to the value to look up
+    Returns: 
+        A bool - true if the bitmap contains a 1 at the index
+    Expects: 
+        (value.*toIndex)() index must be less than 2^37
+    Notes:
+        Goes straight to the backend - the recent filter only holds indices
+        the backend holds too
+    *********************************/
+    bool contains(const T& value) const
+    {
+        uint64_t idx = (value.*toIndex)();
+        if constexpr (Backend == BITMAP_BACKEND) {
+            assert(idx < store.sizeBits);
+            return (store.words[idx >> 6] >> (idx & 63)) & 1;
+        } else {
+            return store.contains(idx);
+        }
+    }
+
+    /************ testBatch *********
+     contains for a whole batch of values, with the memory of every value
+     requested before any of them is looked up
+
+    Parameters: 
+        const T *values - the values to look up
+        size_t count    - how many values there are
+        bool *hits      - hits[i] is set to contains(values[i])
+    Returns: void
+    Notes:
+        The cache misses of the batch overlap instead of happening one 
+        after another. Nothing is added - a value found here is found by 
+        every later testAndSet too (until the next clear), so only the 
+        values it missed still need one
+    *********************************/
+    void testBatch(const T *values, size_t count, bool *hits) const
+    {
+        prefetchBatch(values, count);
+        for (size_t i = 0; i < count; i++) hits[i] = contains(values[i]);
+    }
+
+    /************ prefetchBatch *********
+     prefetch for a whole batch of values
+
+    Parameters: 
+        const T *values - the values that will be tested soon
+        size_t count    - how many values there are
+    Returns: void
+    *********************************/
+    void prefetchBatch(const T *values, size_t count) const
+    {
+        for (size_t i = 0; i < count; i++) prefetch(values[i]);
+    }
+
+    /************ prefetch *********
+     Starts loading the memory testAndSet(value) will touch into the cache
+
+    Parameters: 
+        const T &value - the value that will be tested soon
+    Returns: void
+    Notes:
+        Only a hint - the robin_hood set has no way to prefetch, so for it 
+        this does nothing. Like testAndSet, the sharded backend skips the
+        recent filter
+    *********************************/
+    void prefetch(const T& value) const
+    {
+        uint64_t idx = (value.*toIndex)();
+        if constexpr (USE_RECENT) recent.prefetch(idx);
+        if constexpr (Backend == BITMAP_BACKEND) {
+            __builtin_prefetch(&store.words[idx >> 6], 1);
+        } else if constexpr (Backend == HASH_SET_BACKEND) {
+            (void) idx;
+        } else {
+            store.prefetch(idx);
+        }
+    }
+
+    /************ size *********
+     Returns the number of distinct indices that have been set since the last
+     clear
+
+    Parameters: none
+    Returns: 
+        A uint64_t - the number of 1 bits in the bitmap / entries in the set
+    *********************************/
+    uint64_t size() const
+    {
+        if constexpr (Backend == BITMAP_BACKEND) {
+            return store.numSet;
+        } else {
+            return store.size();
+        }
+    }
+
+    /************ recentHits *********
+     Returns how many testAndSet calls since the last clear were answered by
+     the recent filter alone (always 0 if RECENT_FILTER_LOG2 is 0)
+    *********************************/
+    uint64_t recentHits() const
+    {
+        return numRecentHits;
+    }
+
+    /************ contention *********
+     Returns how many testAndSet calls since the last clear had to wait for 
+     another thread (always 0 for the single-threaded backends)
+    *********************************/
+    uint64_t contention() const
+    {
+        if constexpr (Backend == SHARDED_BACKEND) {
+            return store.contention();
+        } else {
+            return 0;
+        }
+    }
+
+    /************ loadFactor *********
+     Returns how full the underlying storage is
+
+    Parameters: none
+    Returns: 
+        A double - for the bitmap, the fraction of bits that are set. For the
+                   hash sets, the fraction of their slots that are occupied
+    *********************************/
+    double loadFactor() const
+    {
+        if constexpr (Backend == BITMAP_BACKEND) {
+            return double(store.numSet) / double(store.sizeBits);
+        } else if constexpr (Backend == HASH_SET_BACKEND) {
+            return store.load_factor();
+        } else {
+            return store.loadFactor();
+        }
     }
 
 private:
-    IndexFn toIndex;
+    // the sharded backend skips the recent filter, which is not thread safe
+    static constexpr bool USE_RECENT = RECENT_FILTER_LOG2 > 0 && 
+                                       Backend != SHARDED_BACKEND;
+
+    // only the storage the chosen Backend uses is a member at all
+    using Store = std::conditional_t<Backend == BITMAP_BACKEND, msBitmapWords,
+                  std::conditional_t<Backend == HASH_SET_BACKEND, 
+                                     robin_hood::unordered_flat_set<uint64_t>,
+                  std::conditional_t<Backend == QUOTIENT_BACKEND, 
+                                     msQuotientSet, msShardedSet>>>;
+    using Recent = std::conditional_t<USE_RECENT, msRecentFilter, msNoStorage>;
+
+    /************ makeStore *********
+     Builds the chosen Backend's storage for indices below numBits
 
-    #if HAVE_16GB_RAM
-        uint64_t* bitmap = nullptr;
-        uint64_t sizeBits = 0;
-    #else
-        robin_hood::unordered_flat_set<uint64_t> set;
-    #endif
+    Parameters: 
+        uint64_t numBits - one more than the largest index that will be set
+    Returns: 
+        A Store - an empty bitmap, hash set, msQuotientSet or msShardedSet
+    Notes:
+        The bitmap is an anonymous mapping, which is already zeroed - its 
+        pages are only backed by real memory once they are touched
+    *********************************/
+    static Store makeStore(uint64_t numBits)
+    {
+        if constexpr (Backend == BITMAP_BACKEND) {
+            size_t words = (numBits + 63) / 64;
+            void* ptr = mmap(nullptr, words * 8, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            assert(ptr != MAP_FAILED);
+            return msBitmapWords{static_cast<uint64_t*>(ptr), numBits, 0};
+        } else if constexpr (Backend == HASH_SET_BACKEND) {
+            (void) numBits;
+            Store set;
+            set.reserve(INIT_SEEN_SIZE);
+            return set;
+        } else if constexpr (Backend == QUOTIENT_BACKEND) {
+            return msQuotientSet(keyBits(numBits), INIT_QUOTIENT_LOG2);
+        } else {
+            return msShardedSet(keyBits(numBits), SHARD_LOG2, 
+                                INIT_QUOTIENT_LOG2 - SHARD_LOG2);
+        }
+    }
+
+    /************ makeRecent *********
+     Builds the recent filter, or an empty placeholder if it is not used
+    *********************************/
+    static Recent makeRecent()
+    {
+        if constexpr (USE_RECENT) {
+            return msRecentFilter(RECENT_FILTER_LOG2);
+        } else {
+            return msNoStorage{};
+        }
+    }
+
+    /************ keyBits *********
+     Returns how many bits an index below numBits needs
+    *********************************/
+    static int keyBits(uint64_t numBits)
+    {
+        return numBits <= 1 ? 1 : 64 - __builtin_clzll(numBits - 1);
+    }
+
+    IndexFn toIndex;
+    Store store;
+    Recent recent;
+    uint64_t numRecentHits = 0;
 };
 
 #endif
@@ -3,27 +3,51 @@
     January 4th, 2026
     Brendan Roy
 
-    This file implements the msBoard.h interface. An msBoard is a board for
-    French Marble Solitaire, where users can print the board, make moves, and
+    This file implements the msBoard.h interface. An msBasicBoard is a board 
+    for Marble Solitaire, where users can print the board, make moves, and
     generate valid moves. It's designed to be used by another class to
-    implement Marble Solitaire.
+    implement Marble Solitaire. Every function is a template on the board's
+    Shape (see msShape.h), and the shapes we support are explicitly 
+    instantiated at the bottom of this file.
 
 */
 
 #include "configuration.h"
 #include "msBoard.h"
+#include "msCpu.h"
+#include "msTrace.h"
 
 #include <array>
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <stdexcept>
 
 #if HAVE_PEXT
     #include <immintrin.h>
+    /*
+      The versions of the hot kernels that use pext are compiled for BMI2.
+      flatten inlines everything they call, pext64 included - without it
+      pext64 stays a call, since it can't be inlined into the generic 
+      template body first
+    */
+    #define PEXT_TARGET __attribute__((target("bmi2"), flatten))
+#endif
+
+#if HAVE_SIMD_DISPATCH
+    /*
+      The AVX2 and AVX-512 versions of the batch canonicalization kernel 
+      (see canonicalKeysLanes), picked at run time like the pext ones. 
+      flatten inlines every Lanes operator, so each becomes one vector 
+      instruction
+    */
+    #define AVX2_TARGET __attribute__((target("avx2"), flatten))
+    #define AVX512_TARGET __attribute__((target("avx512f"), flatten))
 #endif
 
 
@@ -31,17 +55,22 @@
 
 /************************** structs and types: ****************************/
 /*
-    All boards are represented as a uint64_t. 
+    Boards are represented as an unsigned integer - a uint64_t for every 
+    Shape whose grid fits in 64 bits (all the 7x7 boards), and an unsigned
+    __int128 for larger grids (see ShapeTraits::Word). 
     Each board is structured the same way with the following invariants:
-        - The most significant 49 bits represent the board, but only 36 of 
-            those are valid positions where marbles can be
+        - The most significant NUM_ROWS * NUM_COLS bits represent the board
+            (49 for 7x7 grids), row by row, but only the Shape's playable 
+            positions (37 for the French board) are valid positions where
+            marbles can be
         - Bits corresponding to non-playable positions are always 0
         - Bits corresponding to playable positions are:
             1 = MARBLE
             0 = EMPTY
         - Therefore, a "winning" board has exactly 1 bit set (one marble)
 
-        The default starting board looks like this (ignoring invalid spots):
+        The default French starting board looks like this (ignoring invalid 
+        spots):
                     011
                    11111
                   1111111
@@ -51,32 +80,29 @@
                     111  
             
 */
-using Board = uint64_t;
+template <typename Shape>
+using Board = typename ShapeTraits<Shape>::Word;
 
 /* 
-    Since boards are 7x7 squares (the valid positions do not form a square,
-    but there are 7 rows and 7 columns), each row and column is consists of 
-    7 bits. Here, we define each to be uint8_t, but by convention, we only 
-    use the seven LSB to store information. The MSB (usually 0) is irrelevant
+    Boards are NxN squares (the valid positions do not form a square, but
+    there are N rows and N columns), so each row and column consists of N 
+    bits. Here, we define each to be a Line - a uint8_t for grids up to 8x8
+    and a uint16_t beyond that - but by convention, we only use the N LSB to
+    store information. The remaining MSBs (usually 0) are irrelevant
 */
-using Row = uint8_t;
-using Column = uint8_t;
+template <typename Shape>
+using Row = typename ShapeTraits<Shape>::Line;
+template <typename Shape>
+using Column = typename ShapeTraits<Shape>::Line;
 
 /***** struct Move *****
- Contains all information needed to make a move on any given board
+ Identifies a move on any given board
     Members:
-    uint64_t setBit    - A bit mask of all 0s except one 1 at the bit index
-                            of the position that will be a MARBLE after the 
-                            move is executed
-    uint64_t clearBits - A bit mask of all 0s except two 1s at the bit
-                            indices of the positions that will be EMPTY after
-                            the move is executed
+    uint8_t index - The move's index into MOVE_TABLE<Shape>, which holds the
+                    bits the move changes and its coordinates
 ******************/
 // The struct Move definition is in the msBoard.h file
 
-// ALL_MOVES stores every possible move to be made on the board
-const std::vector<msBoard::Move> msBoard::ALL_MOVES = msBoard::setupAllMoves();
-
 // How the board represents marbles (●) and empty positions (.)
 #define TO_STRING(bit) ((bit) ? "●" : ".")
 
@@ -87,95 +113,121 @@ namespace {
 
     constexpr int NUM_ROTATIONS = 8;
 
-    constexpr int NUM_ROWS = 7;
-    constexpr int NUM_COLS = 7;
-    constexpr int MAX_ROW = NUM_ROWS - 1;
-    constexpr int MAX_COL = NUM_COLS - 1;
-    constexpr int MAX_BOARD_IDX = 63;
-
-
-    const bool PLAYABLE[NUM_ROWS][NUM_COLS] = {
-                                               {0,0,1,1,1,0,0},
-                                               {0,1,1,1,1,1,0},
-                                               {1,1,1,1,1,1,1},
-                                               {1,1,1,1,1,1,1},
-                                               {1,1,1,1,1,1,1},
-                                               {0,1,1,1,1,1,0},
-                                               {0,0,1,1,1,0,0}
-                                              };
-    #define ROW_IDX(r) (MAX_BOARD_IDX - ((r) * NUM_COLS))
-    constexpr int rowShift[NUM_ROWS] = {
-                                        ROW_IDX(0) - (NUM_COLS - 1),
-                                        ROW_IDX(1) - (NUM_COLS - 1),
-                                        ROW_IDX(2) - (NUM_COLS - 1),
-                                        ROW_IDX(3) - (NUM_COLS - 1),
-                                        ROW_IDX(4) - (NUM_COLS - 1),
-                                        ROW_IDX(5) - (NUM_COLS - 1),
-                                        ROW_IDX(6) - (NUM_COLS - 1)
-                                       };
-
-    const uint64_t DEFAULT_BOARD =    0x18FBFFFFEF8E0000; // - empty (0, 2) .14 fastest, .34rn
-    // const Board DEFAULT_BOARD = 0x38FBFFFEEF8E0000; // - empty (2,3) 63s -> 56 -> 43 (w O3) -> 25 (w 16GiB) -> 25 (w REVERSED - others got faster)
-    // const Board DEFAULT_BOARD =    0x38DBFFFFEF8E0000; // - empty (1, 3) 1.47s
-    const Board FULL_BOARD =       0x38FBFFFFEF8E0000;
-    const Board EMPTY_BOARD = 0ULL;
+    template <typename Shape>
+    constexpr int NUM_ROWS = ShapeTraits<Shape>::SIZE;
+    template <typename Shape>
+    constexpr int NUM_COLS = ShapeTraits<Shape>::SIZE;
+    template <typename Shape>
+    constexpr int MAX_ROW = NUM_ROWS<Shape> - 1;
+    template <typename Shape>
+    constexpr int MAX_COL = NUM_COLS<Shape> - 1;
+    template <typename Shape>
+    constexpr int MAX_BOARD_IDX = int(sizeof(Board<Shape>)) * 8 - 1;
+
+    // the N LSB of a Row or Column
+    template <typename Shape>
+    constexpr Row<Shape> LINE_MASK = Row<Shape>((1u << NUM_COLS<Shape>) - 1);
+
+    /************ rowIdx *********
+     Returns the bit index of the first (leftmost) position of a row
+
+    Parameters:
+        int r - the row
+    Returns: 
+        An int - row r occupies bits rowIdx(r) down to rowIdx(r) - MAX_COL
+    *********************************/
+    template <typename Shape>
+    constexpr int rowIdx(int r) {
+        return MAX_BOARD_IDX<Shape> - r * NUM_COLS<Shape>;
+    }
+
+    template <typename Shape>
+    constexpr std::array<int, NUM_ROWS<Shape>> rowShifts() {
+        std::array<int, NUM_ROWS<Shape>> shifts{};
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            shifts[r] = rowIdx<Shape>(r) - MAX_COL<Shape>;
+        }
+        return shifts;
+    }
+
+    // rowShift<Shape>[r] shifts row r down to the LSB of a Board
+    template <typename Shape>
+    constexpr std::array<int, NUM_ROWS<Shape>> rowShift = rowShifts<Shape>();
+
+    template <typename Shape>
+    constexpr Board<Shape> EMPTY_BOARD = 0;
 
     
     const int WINNING_MARBLE_COUNT = 1;
 
     /* 
-      COL_START_IDX[i] and COL_END_IDX[i] indicate at what indices of a 7x7 
-      board the valid columns (where marbles can be) in row i begin and end. 
-      Treating board as a 2d array, every  index board[i][j] is valid
-      for 0 <= i < NUM_ROWS and COL_START_IDX[i] <= j <= COL_END_IDX[i].
-                                     Note the <= sign ^
+      Shape::PLAYABLE[r][c] is true iff (r, c) is a position marbles can be in
+
+      COL_START_IDX<Shape>[i] and COL_END_IDX<Shape>[i] indicate at what 
+      indices of the grid the valid columns (where marbles can be) in row i 
+      begin and end. Treating board as a 2d array, every index board[i][j] is 
+      valid for 0 <= i < NUM_ROWS and COL_START_IDX[i] <= j <= COL_END_IDX[i].
+                                                    Note the <= sign ^
+      For the French board these are {2,1,0,0,0,1,2} and {4,5,6,6,6,5,4}
     */
-    const int COL_START_IDX[] = {2,1,0,0,0,1,2};
-    const int COL_END_IDX[]   = {4,5,6,6,6,5,4};
-    
+    template <typename Shape>
+    constexpr std::array<int, NUM_ROWS<Shape>> COL_START_IDX = 
+                                            ShapeTraits<Shape>::COL_START;
+    template <typename Shape>
+    constexpr std::array<int, NUM_ROWS<Shape>> COL_END_IDX = 
+                                            ShapeTraits<Shape>::COL_END;
 
-    std::array<uint8_t, 128> reverseAllRowCols();
-    std::array<Board, NUM_COLS> getColMasks();
+    /* 
+      SYMMETRIES<Shape> has bit t set iff Transform t maps the Shape onto 
+      itself - only those transforms are valid for canonicalization
+    */
+    template <typename Shape>
+    constexpr uint8_t SYMMETRIES = ShapeTraits<Shape>::SYMMETRIES;
 
-    const std::array<uint8_t, 128> REVERSED = reverseAllRowCols();
-    const std::array<Board, NUM_COLS> COL_MASKS = getColMasks();
+    
+    // one entry per possible Row - 128 for 7x7 grids, 512 for 9x9 grids
+    template <typename Shape>
+    using ReversedTable = std::array<Row<Shape>, (1u << NUM_COLS<Shape>)>;
 
     /************************ Private Helper Functions ************************/
 
-   /************ reverse7 *********
-     Reverses the least significant 7 bits of an integer - can take in either
-     a Row or a Column
+   /************ reverseLine *********
+     Reverses the least significant N bits of an integer (N = NUM_COLS) - can
+     take in either a Row or a Column
 
     Parameters: 
-        uint8_t x - an 8-bit integer that we reverse 
+        unsigned x - the line that we reverse 
     Returns: 
-        A uint8_t - MSB is 0, next 7 are the 7 LSB from x in reverse order
+        A Row - the N LSB are the N LSB from x in reverse order, the rest are 0
     Expects: 
         Nothing
     Notes:
-        The MSB of x is ignored and does not affect the return value
+        Bits of x above the N LSB are ignored and do not affect the return 
+        value
     *********************************/
-    inline uint8_t reverse7(uint8_t x) {
-        uint8_t rev = 0;
-        rev |= (x & 0x01) << 6; // bit0 -> bit6
-        rev |= (x & 0x02) << 4; // bit1 -> bit5
-        rev |= (x & 0x04) << 2; // bit2 -> bit4
-        rev |= (x & 0x08);      // bit3 -> bit3
-        rev |= (x & 0x10) >> 2; // bit4 -> bit2
-        rev |= (x & 0x20) >> 4; // bit5 -> bit1
-        rev |= (x & 0x40) >> 6; // bit6 -> bit0
+    template <typename Shape>
+    constexpr Row<Shape> reverseLine(unsigned x) {
+        Row<Shape> rev = 0;
+        for (int i = 0; i < NUM_COLS<Shape>; i++) {
+            rev |= Row<Shape>(((x >> i) & 1u) << (MAX_COL<Shape> - i));
+        }
         return rev;
     }
 
-    std::array<uint8_t, 128> reverseAllRowCols()
+    template <typename Shape>
+    constexpr ReversedTable<Shape> reverseAllRowCols()
     {
-        std::array<uint8_t, 128> reversed;
-        for (int i = 0; i < 128; i++) {
-            reversed[i] = reverse7(i);
+        ReversedTable<Shape> reversed{};
+        for (unsigned i = 0; i < reversed.size(); i++) {
+            reversed[i] = reverseLine<Shape>(i);
         }
         return reversed;
     }
 
+    // REVERSED<Shape>[x] is the Row (or Column) x with its N bits reversed
+    template <typename Shape>
+    constexpr ReversedTable<Shape> REVERSED = reverseAllRowCols<Shape>();
+
 
     /************ bitIndex *********
      Returns the bit index of a given position on the board
@@ -187,14 +239,64 @@ namespace {
         An unsigned integer that corresponds to the given position's coordinates 
         on a board - note that boards are indexed starting from the MSB
     Expects: 
-        Both row and col must be less than 7
-    Notes:
-        Will CRE if row or col >= 7
+        Both row and col must be less than NUM_ROWS (7 for 7x7 grids)
     *********************************/
-    inline unsigned bitIndex(unsigned r, unsigned c) {
-        return ROW_IDX(r) - c;
+    template <typename Shape>
+    constexpr unsigned bitIndex(unsigned r, unsigned c) {
+        return rowIdx<Shape>(r) - c;
     }
 
+    /************ popcount *********
+     Counts the 1 bits of a Board of either width
+
+    Parameters: 
+        Word b - the board to count
+    Returns: 
+        An int - the number of set bits in b
+    *********************************/
+    inline int popcount(uint64_t b) {
+        return __builtin_popcountll(b);
+    }
+
+    inline int popcount(uint128_t b) {
+        return __builtin_popcountll(uint64_t(b)) + 
+               __builtin_popcountll(uint64_t(b >> 64));
+    }
+
+    /************ fullBoard *********
+     Builds the board with a marble on every playable position of a Shape
+
+    Parameters: none
+    Returns: 
+        A Board - 0x38FBFFFFEF8E0000 for the French board
+    *********************************/
+    template <typename Shape>
+    constexpr Board<Shape> fullBoard() {
+        Board<Shape> b = EMPTY_BOARD<Shape>;
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            for (int c = 0; c < NUM_COLS<Shape>; c++) {
+                if (Shape::PLAYABLE[r][c]) 
+                    b |= Board<Shape>(1) << bitIndex<Shape>(r, c);
+            }
+        }
+        return b;
+    }
+
+    /*
+      FULL_BOARD<Shape> has every playable position filled. DEFAULT_BOARD 
+      is the same but with the Shape's default empty position
+      French:  0x18FBFFFFEF8E0000 - empty (0, 2) .14 fastest, .34rn
+               0x38FBFFFEEF8E0000 - empty (2,3) 63s -> 56 -> 43 (w O3) -> 
+                                    25 (w 16GiB) -> 25 (w REVERSED)
+               0x38DBFFFFEF8E0000 - empty (1, 3) 1.47s
+    */
+    template <typename Shape>
+    constexpr Board<Shape> FULL_BOARD = fullBoard<Shape>();
+    template <typename Shape>
+    constexpr Board<Shape> DEFAULT_BOARD = FULL_BOARD<Shape> & 
+                ~(Board<Shape>(1) << bitIndex<Shape>(Shape::DEFAULT_EMPTY_ROW, 
+                                                     Shape::DEFAULT_EMPTY_COL));
+
 
     /************ getRow *********
      Gets a row from a given board
@@ -203,8 +305,8 @@ namespace {
         Board b    - the board that we retrieve the row from
         unsigned r - the row number that we get
     Returns: 
-        A uint8_t containing the bits of the given row. The MSB is always 0,
-        the next 7 are the bits of row number 2 in b, in left-to-right order
+        A Row containing the bits of the given row in its N LSB, in 
+        left-to-right order. The bits above those are always 0
     Expects: 
         b should follow the Board invariants
         r must be a valid row number
@@ -213,10 +315,11 @@ namespace {
         Will return an invalid Board if given one - does not check the board's
         validity
     *********************************/
-    inline Row getRow(Board b, unsigned r) {
-        assert(r < NUM_ROWS);
+    template <typename Shape>
+    inline Row<Shape> getRow(Board<Shape> b, unsigned r) {
+        assert(r < NUM_ROWS<Shape>);
 
-        return (b >> rowShift[r]) & 0x7F;
+        return Row<Shape>(b >> rowShift<Shape>[r]) & LINE_MASK<Shape>;
     }
 
 
@@ -228,9 +331,9 @@ namespace {
     Parameters: 
         Board b         - the board that we update, passed by value
         unsigned r      - the row that we modify
-        uint8_t rowBits - the new row that replaces the row number r in b
+        Row rowBits     - the new row that replaces the row number r in b
     Returns: 
-        An updated version of b - row r of b is substituted with the 7 LSB of
+        An updated version of b - row r of b is substituted with the N LSB of
         rowBits, ordered from most significant to least in the row
     Expects: 
         r must be a valid row number (r < NUM_ROWS)
@@ -239,16 +342,94 @@ namespace {
           that does not follow the invariants. Invalid input would consist of a
           row of all 1s with r = 0 --> violates void positions of board being 
           set to 0
-        - The MSB of rowBits is ignored
+        - The bits of rowBits above the N LSB are ignored
         - Will CRE if r >= NUM_ROWS
     *********************************/
-    inline Board insertRow(Board b, unsigned r, Row rowBits) {
-        assert(r < NUM_ROWS);
+    template <typename Shape>
+    inline Board<Shape> insertRow(Board<Shape> b, unsigned r, 
+                                  Row<Shape> rowBits) {
+        assert(r < NUM_ROWS<Shape>);
+
+        return (b & ~(Board<Shape>(LINE_MASK<Shape>) << rowShift<Shape>[r])) |
+               Board<Shape>(rowBits & LINE_MASK<Shape>) << rowShift<Shape>[r];
+    }
+
+
+    template <typename Shape>
+    constexpr std::array<Board<Shape>, NUM_COLS<Shape>> getColMasks()
+    {
+        std::array<Board<Shape>, NUM_COLS<Shape>> masks{};
+        for (int c = 0; c < NUM_COLS<Shape>; c++) {
+            masks[c] = EMPTY_BOARD<Shape>;
+            for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+                masks[c] |= Board<Shape>(1) << (rowIdx<Shape>(r) - c);
+            }
+        }
+        return masks;
+    }
+
+    // COL_MASKS<Shape>[c] has a 1 at every position of column c (for pext)
+    template <typename Shape>
+    constexpr std::array<Board<Shape>, NUM_COLS<Shape>> COL_MASKS = 
+                                                        getColMasks<Shape>();
+
+
+    /*
+      Magic multiplication column gathering, as chess engines do for files:
+      masking a column leaves its N bits NUM_COLS apart, and multiplying by
+      COL_MAGIC<Shape>[c] adds one shifted copy of them per row, placed so 
+      that row r's bit of its own copy lands on bit MAGIC_SHIFT + MAX_ROW - r.
+      The column then reads off the top N bits of the product. Copies of 
+      the other rows land elsewhere, and COL_MAGIC_OK checks every column 
+      against all 2^N values it can hold that none of them carries into 
+      those top bits. Only used for 64 bit boards
+    */
+    template <typename Shape>
+    constexpr int MAGIC_SHIFT = 64 - NUM_ROWS<Shape>;
+
+    template <typename Shape>
+    constexpr std::array<uint64_t, NUM_COLS<Shape>> getColMagics()
+    {
+        std::array<uint64_t, NUM_COLS<Shape>> magics{};
+        for (int c = 0; c < NUM_COLS<Shape>; c++) {
+            for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+                int shift = MAGIC_SHIFT<Shape> + MAX_ROW<Shape> - r - 
+                            (rowIdx<Shape>(r) - c);
+                if (shift < 0) return {};
+                magics[c] |= uint64_t(1) << shift;
+            }
+        }
+        return magics;
+    }
 
-        return (b & ~(Board(0x7F) << (rowShift[r]))) |
-               (Board)rowBits << rowShift[r];
+    template <typename Shape>
+    constexpr std::array<uint64_t, NUM_COLS<Shape>> COL_MAGICS = 
+                                                        getColMagics<Shape>();
+
+    template <typename Shape>
+    constexpr bool colMagicsWork()
+    {
+        if (sizeof(Board<Shape>) != sizeof(uint64_t)) return false;
+        for (int c = 0; c < NUM_COLS<Shape>; c++) {
+            if (COL_MAGICS<Shape>[c] == 0) return false;
+            for (unsigned col = 0; col < (1u << NUM_ROWS<Shape>); col++) {
+                uint64_t b = 0;
+                for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+                    if ((col >> (MAX_ROW<Shape> - r)) & 1u)
+                        b |= uint64_t(1) << (rowIdx<Shape>(r) - c);
+                }
+                if ((b * COL_MAGICS<Shape>[c]) >> MAGIC_SHIFT<Shape> != col)
+                    return false;
+            }
+        }
+        return true;
     }
 
+    template <typename Shape>
+    constexpr bool COL_MAGIC_OK = colMagicsWork<Shape>();
+    static_assert(COL_MAGIC_OK<FrenchShape> && COL_MAGIC_OK<EnglishShape>,
+                  "7x7 columns must be gatherable with one multiply");
+
 
     /************ getCol *********
      Get a specific column from a given board
@@ -257,8 +438,8 @@ namespace {
         Board b    - the board that we retrieve from, passed by value
         unsigned c - the column index to retrieve
     Returns: 
-        A uint8_t containing the bits of the given column. The MSB is always 0,
-        the next 7 are the bits of board's c column, in top-to-bottom order 
+        A Column containing the bits of the given column in its N LSB, in 
+        top-to-bottom order. The bits above those are always 0
     Expects: 
         b should follow Board's invariants
         c must be a valid column number (ie c < NUM_COLS)
@@ -266,38 +447,37 @@ namespace {
         Will CRE if c >= NUM_COLS
         Will return an invalid Board if given one - does not check the board's
         validity
+        PEXT may only be true inside a PEXT_TARGET function, running on a 
+        cpu with BMI2 (see msCpu.h). Otherwise 64 bit boards use a magic 
+        multiplication (see COL_MAGICS) if ENABLE_MAGIC_COLUMNS is set, and
+        wider boards gather bit by bit
     *********************************/
-    inline Column getCol(Board b, unsigned c) {
-        assert(c < NUM_COLS);
-       #if HAVE_PEXT
-            return (Column)_pext_u64(b, COL_MASKS[c]);
-       #else
-           return ((b >> (ROW_IDX(0) - c)) & 1ULL) << 6 |
-                  ((b >> (ROW_IDX(1) - c)) & 1ULL) << 5 |
-                  ((b >> (ROW_IDX(2) - c)) & 1ULL) << 4 |
-                  ((b >> (ROW_IDX(3) - c)) & 1ULL) << 3 |
-                  ((b >> (ROW_IDX(4) - c)) & 1ULL) << 2 |
-                  ((b >> (ROW_IDX(5) - c)) & 1ULL) << 1 |
-                  ((b >> (ROW_IDX(6) - c)) & 1ULL) << 0;
-       #endif
+#if HAVE_PEXT
+    PEXT_TARGET inline uint64_t pext64(uint64_t b, uint64_t mask) {
+        return _pext_u64(b, mask);
     }
-    
+#endif
 
-    std::array<Board, NUM_COLS> getColMasks()
-    {
-        std::array<Board, NUM_COLS> masks;
-        for (int c = 0; c < NUM_COLS; c++) {
-            masks[c] = (1ULL << (ROW_IDX(0) - c)) |
-                       (1ULL << (ROW_IDX(1) - c)) |
-                       (1ULL << (ROW_IDX(2) - c)) |
-                       (1ULL << (ROW_IDX(3) - c)) |
-                       (1ULL << (ROW_IDX(4) - c)) |
-                       (1ULL << (ROW_IDX(5) - c)) |
-                       (1ULL << (ROW_IDX(6) - c));
+    template <typename Shape, bool PEXT = false>
+    inline Column<Shape> getCol(Board<Shape> b, unsigned c) {
+        assert(c < NUM_COLS<Shape>);
+       #if HAVE_PEXT
+        if constexpr (PEXT && sizeof(Board<Shape>) == sizeof(uint64_t)) {
+            return (Column<Shape>)pext64(b, COL_MASKS<Shape>[c]);
         }
-        return masks;
+       #endif
+        if constexpr (ENABLE_MAGIC_COLUMNS && COL_MAGIC_OK<Shape>) {
+            return Column<Shape>(((b & COL_MASKS<Shape>[c]) * 
+                                  COL_MAGICS<Shape>[c]) >> MAGIC_SHIFT<Shape>);
+        }
+        Column<Shape> col = 0;
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            col |= Column<Shape>(((b >> (rowIdx<Shape>(r) - c)) & 1u) 
+                                 << (MAX_ROW<Shape> - r));
+        }
+        return col;
     }
- 
+    
 
     /************ getBit *********
      Gets a bit from a Board at a given index - returns the bit in the LSB of
@@ -314,11 +494,218 @@ namespace {
     Notes:
         Will CRE if r > NUM_ROWS or if c > NUM_COLS
     *********************************/
-    inline uint64_t getBit(Board b, unsigned r, unsigned c) {
-        assert(r < NUM_ROWS);
-        assert(c < NUM_COLS);
+    template <typename Shape>
+    inline uint64_t getBit(Board<Shape> b, unsigned r, unsigned c) {
+        assert(r < NUM_ROWS<Shape>);
+        assert(c < NUM_COLS<Shape>);
+
+        return uint64_t(b >> bitIndex<Shape>(r, c)) & 1ULL;
+    }
+
+    /***************************** Padded layout ******************************/
+    /*
+      For the symmetries, a 64 bit board is spread out to an 8x8 grid with 
+      one byte per row: cell (r, c) moves from bit rowIdx(r) - c to bit 
+      63 - 8r - c, and the row and column past the Shape's last are 0. The
+      order of the cells is unchanged, so padded boards compare exactly like
+      the boards they came from. In this layout:
+        - flipping the rows is a byte swap
+        - flipping the columns reverses the bits of every byte
+        - the diagonal flip is the usual 3 step 8x8 bit-matrix transpose
+      and every other symmetry is a composition of those. The grid starts 
+      at the top left corner, so both flips shift the result back by the 
+      PAD missing rows or columns. Only shapes of up to 8x8 have this 
+      layout - wider boards keep building their images row by row
+    */
+    template <typename Shape>
+    constexpr int PAD = 8 - NUM_ROWS<Shape>;
+
+    /*
+      Going to the padded layout moves row r right by r * PAD bits, in 3 
+      steps - step k moves the rows with bit k of r set by 2^k * PAD bits, 
+      largest step first. PADDED_STEP_MASKS<Shape>[k] holds the bits those
+      rows sit at just before step k. Coming back runs the steps in reverse
+    */
+    template <typename Shape>
+    constexpr std::array<uint64_t, 3> getPaddedStepMasks()
+    {
+        std::array<uint64_t, 3> masks{};
+        if (NUM_ROWS<Shape> > 8) return masks;
+        int shift[8] = {};
+        for (int k = 2; k >= 0; k--) {
+            for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+                if (!((r >> k) & 1)) continue;
+                for (int c = 0; c < NUM_COLS<Shape>; c++) {
+                    masks[k] |= uint64_t(1) << (63 - NUM_COLS<Shape> * r - c -
+                                                shift[r]);
+                }
+                shift[r] += (1 << k) * PAD<Shape>;
+            }
+        }
+        return masks;
+    }
+
+    template <typename Shape>
+    constexpr std::array<uint64_t, 3> PADDED_STEP_MASKS = 
+                                                getPaddedStepMasks<Shape>();
+
+    // PADDED_CELLS<Shape> has a 1 at every cell of the padded grid
+    template <typename Shape>
+    constexpr uint64_t getPaddedCells()
+    {
+        uint64_t cells = 0;
+        if (NUM_ROWS<Shape> > 8) return cells;
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            for (int c = 0; c < NUM_COLS<Shape>; c++) {
+                cells |= uint64_t(1) << (63 - 8 * r - c);
+            }
+        }
+        return cells;
+    }
+
+    template <typename Shape>
+    constexpr uint64_t PADDED_CELLS = getPaddedCells<Shape>();
+
+    /************ toPadded / fromPadded *********
+     Moves a board to the padded layout, and back
+
+    Parameters: 
+        T b - the board (or padded board) to move, or a Lanes of them
+    Returns: 
+        A T - b in the other layout
+    Expects:
+        PADDED_OK<Shape>
+    Notes:
+        PEXT may only be true inside a PEXT_TARGET function, where a single
+        pdep or pext does the job
+    *********************************/
+#if HAVE_PEXT
+    PEXT_TARGET inline uint64_t pdep64(uint64_t b, uint64_t mask) {
+        return _pdep_u64(b, mask);
+    }
+#endif
+
+    template <typename Shape, bool PEXT = false, typename T = uint64_t>
+    inline T toPadded(T b) {
+       #if HAVE_PEXT
+        constexpr int LOW = 64 - NUM_ROWS<Shape> * NUM_COLS<Shape>;
+        if constexpr (PEXT) return pdep64(b >> LOW, PADDED_CELLS<Shape>);
+       #endif
+        for (int k = 2; k >= 0; k--) {
+            const uint64_t m = PADDED_STEP_MASKS<Shape>[k];
+            b = (b & ~m) | ((b & m) >> ((1 << k) * PAD<Shape>));
+        }
+        return b;
+    }
+
+    template <typename Shape, bool PEXT = false, typename T = uint64_t>
+    inline T fromPadded(T p) {
+       #if HAVE_PEXT
+        constexpr int LOW = 64 - NUM_ROWS<Shape> * NUM_COLS<Shape>;
+        if constexpr (PEXT) return pext64(p, PADDED_CELLS<Shape>) << LOW;
+       #endif
+        for (int k = 0; k <= 2; k++) {
+            const int s = (1 << k) * PAD<Shape>;
+            const uint64_t m = PADDED_STEP_MASKS<Shape>[k] >> s;
+            p = (p & ~m) | ((p & m) << s);
+        }
+        return p;
+    }
+
+    /*
+      Whether a Shape gets the padded layout - its boards must be 64 bits, 
+      and no step of toPadded may move a row onto one that hasn't moved yet
+    */
+    template <typename Shape>
+    constexpr bool paddedLayoutWorks()
+    {
+        constexpr int CELLS = NUM_ROWS<Shape> * NUM_COLS<Shape>;
+        if (CELLS > 64) return false;
+        uint64_t board = ~uint64_t(0) << (64 - std::min(CELLS, 64));
+        for (int k = 2; k >= 0; k--) {
+            const uint64_t m = PADDED_STEP_MASKS<Shape>[k];
+            if (((board & m) != m) || 
+                (((m >> ((1 << k) * PAD<Shape>)) & (board & ~m)) != 0))
+                return false;
+            board = (board & ~m) | (m >> ((1 << k) * PAD<Shape>));
+        }
+        return board == PADDED_CELLS<Shape>;
+    }
+
+    template <typename Shape>
+    constexpr bool PADDED_OK = paddedLayoutWorks<Shape>();
+    static_assert(PADDED_OK<FrenchShape> && PADDED_OK<EnglishShape>,
+                  "7x7 boards must have the padded layout");
+
+    /************ flipRows / flipCols / flipDiag *********
+     The three generating symmetries of a padded board: (r, c) goes to 
+     (N-1-r, c), (r, N-1-c) and (c, r)
+
+    Notes:
+        T is a uint64_t, or a Lanes of them (see canonicalKeysLanes) - 
+        Lanes swap their bytes with shifts, as there is no vector bswap
+    *********************************/
+    template <typename Shape, typename T>
+    inline T flipRows(T p) {
+        if constexpr (std::is_same_v<T, uint64_t>) {
+            p = __builtin_bswap64(p);
+        } else {
+            p = ((p >> 8) & 0x00FF00FF00FF00FFULL) | 
+                ((p & 0x00FF00FF00FF00FFULL) << 8);
+            p = ((p >> 16) & 0x0000FFFF0000FFFFULL) | 
+                ((p & 0x0000FFFF0000FFFFULL) << 16);
+            p = (p >> 32) | (p << 32);
+        }
+        return p << (8 * PAD<Shape>);
+    }
+
+    template <typename Shape, typename T>
+    inline T flipCols(T p) {
+        p = ((p >> 1) & 0x5555555555555555ULL) | 
+            ((p & 0x5555555555555555ULL) << 1);
+        p = ((p >> 2) & 0x3333333333333333ULL) | 
+            ((p & 0x3333333333333333ULL) << 2);
+        p = ((p >> 4) & 0x0F0F0F0F0F0F0F0FULL) | 
+            ((p & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return p << PAD<Shape>;
+    }
 
-        return (b >> bitIndex(r, c)) & 1ULL;
+    template <typename T>
+    inline T flipDiag(T p) {
+        T t;
+        t = 0x0F0F0F0F00000000ULL & (p ^ (p << 28));
+        p ^= t ^ (t >> 28);
+        t = 0x3333000033330000ULL & (p ^ (p << 14));
+        p ^= t ^ (t >> 14);
+        t = 0x5500550055005500ULL & (p ^ (p << 7));
+        p ^= t ^ (t >> 7);
+        return p;
+    }
+
+    /************ paddedImages *********
+     Builds all 8 images of a padded board
+
+    Parameters: 
+        T p         - the padded board (or a Lanes of them)
+        T images[8] - images[t] is set to Transform t of p
+    Notes:
+        Images the caller never reads are optimized away
+    *********************************/
+    template <typename Shape, typename T>
+    inline void paddedImages(T p, T images[]) {
+        using msBoard = msBasicBoard<Shape>;
+        const T d = flipDiag(p);
+        const T h = flipCols<Shape>(p);
+        const T dh = flipCols<Shape>(d);
+
+        images[msBoard::DEGREE_0]   = p;
+        images[msBoard::DEGREE_90]  = flipRows<Shape>(d);
+        images[msBoard::DEGREE_180] = flipRows<Shape>(h);
+        images[msBoard::DEGREE_270] = dh;
+        images[msBoard::FLIP_H]     = h;
+        images[msBoard::FLIP_V]     = flipRows<Shape>(p);
+        images[msBoard::FLIP_DIAG]  = d;
+        images[msBoard::FLIP_ANTI]  = flipRows<Shape>(dh);
     }
 
      /************ transformBoard *********
@@ -331,57 +718,468 @@ namespace {
     Returns: 
         A new, transformed version of b
     *********************************/
-    inline Board transformBoard(Board b, msBoard::Transform t) {
-        Board out = EMPTY_BOARD;
+    template <typename Shape>
+    inline Board<Shape> transformBoard(Board<Shape> b, 
+                                typename msBasicBoard<Shape>::Transform t) {
+        using msBoard = msBasicBoard<Shape>;
+        constexpr int ROWS = NUM_ROWS<Shape>;
+        constexpr int LAST = MAX_ROW<Shape>;
+        const ReversedTable<Shape> &REV = REVERSED<Shape>;
+        Board<Shape> out = EMPTY_BOARD<Shape>;
+
+        if constexpr (ENABLE_PADDED_SYMMETRIES && PADDED_OK<Shape>) {
+            uint64_t images[NUM_ROTATIONS];
+            paddedImages<Shape>(toPadded<Shape>(b), images);
+            return fromPadded<Shape>(images[t]);
+        }
 
         switch(t) {
             case msBoard::DEGREE_0: return b;
             case msBoard::DEGREE_90:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Column col = getCol(b,i);
-                    out = insertRow(out, MAX_ROW - i, col);
+                for (int i = 0; i < ROWS; i++) {
+                    Column<Shape> col = getCol<Shape>(b,i);
+                    out = insertRow<Shape>(out, LAST - i, col);
                 }
                 break;
             case msBoard::DEGREE_180:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Row row = getRow(b,i);
-                    out = insertRow(out, MAX_ROW - i, REVERSED[row]);
+                for (int i = 0; i < ROWS; i++) {
+                    Row<Shape> row = getRow<Shape>(b,i);
+                    out = insertRow<Shape>(out, LAST - i, REV[row]);
                 }
                 break;
             case msBoard::DEGREE_270:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Column col = getCol(b,i);
-                    out = insertRow(out, i, REVERSED[col]);
+                for (int i = 0; i < ROWS; i++) {
+                    Column<Shape> col = getCol<Shape>(b,i);
+                    out = insertRow<Shape>(out, i, REV[col]);
                 }
                 break;
             case msBoard::FLIP_H:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Row row = getRow(b,i);
-                    out = insertRow(out, i, REVERSED[row]);
+                for (int i = 0; i < ROWS; i++) {
+                    Row<Shape> row = getRow<Shape>(b,i);
+                    out = insertRow<Shape>(out, i, REV[row]);
                 }
                 break;
             case msBoard::FLIP_V:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Row row = getRow(b,i);
-                    out = insertRow(out, MAX_ROW - i, row);
+                for (int i = 0; i < ROWS; i++) {
+                    Row<Shape> row = getRow<Shape>(b,i);
+                    out = insertRow<Shape>(out, LAST - i, row);
                 }
                 break;
             case msBoard::FLIP_DIAG:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Column col = getCol(b,i);
-                    out = insertRow(out, i, col);
+                for (int i = 0; i < ROWS; i++) {
+                    Column<Shape> col = getCol<Shape>(b,i);
+                    out = insertRow<Shape>(out, i, col);
                 }
                 break;
             case msBoard::FLIP_ANTI:
-                for (int i = 0; i < NUM_ROWS; i++) {
-                    Column col = getCol(b,i);
-                    out = insertRow(out, MAX_ROW - i, REVERSED[col]);
+                for (int i = 0; i < ROWS; i++) {
+                    Column<Shape> col = getCol<Shape>(b,i);
+                    out = insertRow<Shape>(out, LAST - i, REV[col]);
                 }
                 break;
         }
         return out;
     }
 
+    /******************************* D4 group *********************************/
+
+    /************ composeAll *********
+     Builds the multiplication table of the 8 board symmetries (the dihedral
+     group D4), numbered like msBasicBoard::Transform
+
+    Parameters: none
+    Returns: 
+        An 8x8 table - table[first][second] is the single Transform that has
+        the same effect as applying first and then second
+    Notes:
+        Only evaluated at compile time. Two positions of a 3x3 grid are 
+        enough to tell every symmetry apart, so those are all we compare
+    *********************************/
+    constexpr std::array<std::array<uint8_t, NUM_ROTATIONS>, NUM_ROTATIONS> 
+                                                                composeAll()
+    {
+        constexpr int PROBE_SIZE = 3;
+        constexpr int PROBES[2][2] = { { 0, 0 }, { 0, 1 } };
+        std::array<std::array<uint8_t, NUM_ROTATIONS>, NUM_ROTATIONS> table{};
+
+        for (int a = 0; a < NUM_ROTATIONS; a++) {
+            for (int b = 0; b < NUM_ROTATIONS; b++) {
+                for (int c = 0; c < NUM_ROTATIONS; c++) {
+                    bool same = true;
+                    for (const auto &p : PROBES) {
+                        int r1 = 0, c1 = 0, r2 = 0, c2 = 0, r3 = 0, c3 = 0;
+                        transformCell(PROBE_SIZE, a, p[0], p[1], r1, c1);
+                        transformCell(PROBE_SIZE, b, r1, c1, r2, c2);
+                        transformCell(PROBE_SIZE, c, p[0], p[1], r3, c3);
+                        same &= (r2 == r3) && (c2 == c3);
+                    }
+                    if (same) table[a][b] = uint8_t(c);
+                }
+            }
+        }
+        return table;
+    }
+
+    constexpr std::array<uint8_t, NUM_ROTATIONS> inverseAll()
+    {
+        constexpr auto COMPOSE = composeAll();
+        std::array<uint8_t, NUM_ROTATIONS> inverse{};
+        for (int a = 0; a < NUM_ROTATIONS; a++) {
+            for (int b = 0; b < NUM_ROTATIONS; b++) {
+                if (COMPOSE[a][b] == 0) inverse[a] = uint8_t(b);
+            }
+        }
+        return inverse;
+    }
+
+    /*
+      D4_COMPOSE[first][second] is first followed by second, and 
+      D4_INVERSE[t] undoes t. A chain of transforms is therefore always 
+      just one Transform
+    */
+    constexpr std::array<std::array<uint8_t, NUM_ROTATIONS>, NUM_ROTATIONS> 
+                                                    D4_COMPOSE = composeAll();
+    constexpr std::array<uint8_t, NUM_ROTATIONS> D4_INVERSE = inverseAll();
+
+    static_assert(D4_COMPOSE[1][1] == 2 && D4_INVERSE[1] == 3 && 
+                  D4_COMPOSE[4][5] == 2, 
+                  "D4 table must agree with transformCell");
+
+    /****************************** Move table ********************************/
+
+    /*
+      The four directions a marble can jump in, in the order the solver tries
+      them. DR[d] and DC[d] are the row and column steps of direction d
+    */
+    enum Direction { UP = 0, DOWN, LEFT, RIGHT, NUM_DIRECTIONS };
+    constexpr int DR[NUM_DIRECTIONS] = { -1, 1, 0, 0 };
+    constexpr int DC[NUM_DIRECTIONS] = { 0, 0, -1, 1 };
+    const char *const DIRECTION_NAMES[NUM_DIRECTIONS] = { "up", "down", 
+                                                          "left", "right" };
+
+    // marks a (position, direction) pair that is not a move on the Shape
+    constexpr uint8_t NO_MOVE = 0xFF;
+
+    /***** struct MoveMasks *****
+     The bits of a board that a move changes
+        Members:
+        Board setBit    - A bit mask of all 0s except one 1 at the bit index
+                                of the position that will be a MARBLE after the 
+                                move is executed
+        Board clearBits - A bit mask of all 0s except two 1s at the bit
+                                indices of the positions that will be EMPTY 
+                                after the move is executed
+    ******************/
+    template <typename Shape>
+    struct MoveMasks {
+        Board<Shape> setBit;
+        Board<Shape> clearBits;
+    };
+
+    /***** struct MoveCoords *****
+     Where a move starts and which way it jumps
+        Members:
+        uint8_t srcRow, srcCol - the position of the marble that jumps
+        uint8_t dir            - the Direction it jumps in
+    ******************/
+    struct MoveCoords {
+        uint8_t srcRow;
+        uint8_t srcCol;
+        uint8_t dir;
+    };
+
+    /***** struct MoveTable *****
+     Everything about every move of a Shape, indexed by Move::index
+        Members:
+        masks[i]     - the MoveMasks of move i - the only part validMoves,
+                       applyMove and undoMove touch, so it is kept apart
+        coords[i]    - the MoveCoords of move i
+        ids[r][c][d] - the index of the move from (r, c) in Direction d, or
+                       NO_MOVE if there is no such move on the Shape
+        images[t][i] - the index of move i after Transform t is applied to
+                       the board, or NO_MOVE if t is not a symmetry of the 
+                       Shape and moves i off of it
+        interference[i] - a bit set (one bit per move) of every move that 
+                       touches one of the three positions move i touches, 
+                       including move i. Moves that do not interfere commute
+    ******************/
+    template <typename Shape>
+    struct MoveTable {
+        std::array<MoveMasks<Shape>, ShapeTraits<Shape>::NUM_MOVES> masks;
+        std::array<MoveCoords, ShapeTraits<Shape>::NUM_MOVES> coords;
+        uint8_t ids[NUM_ROWS<Shape>][NUM_COLS<Shape>][NUM_DIRECTIONS];
+        uint8_t images[NUM_ROTATIONS][ShapeTraits<Shape>::NUM_MOVES];
+        uint64_t interference[ShapeTraits<Shape>::NUM_MOVES]
+                             [(ShapeTraits<Shape>::NUM_MOVES + 63) / 64];
+    };
+
+    /************ isPlayable *********
+     Returns whether a position is on the grid and playable on the Shape
+
+    Parameters:
+        int r, int c - the position, which may be off the grid
+    Returns: 
+        A bool - true iff (r, c) is a position marbles can be in
+    *********************************/
+    template <typename Shape>
+    constexpr bool isPlayable(int r, int c) {
+        return r >= 0 && r < NUM_ROWS<Shape> && c >= 0 && c < NUM_COLS<Shape> &&
+               Shape::PLAYABLE[r][c];
+    }
+
+    /************ directionOf *********
+     Returns the Direction of a jump from its row and column deltas
+
+    Parameters:
+        int dRow, int dCol - the destination minus the source position
+    Returns: 
+        A Direction
+    Expects: 
+        exactly one of dRow and dCol is 0
+    *********************************/
+    constexpr Direction directionOf(int dRow, int dCol) {
+        if (dRow < 0) return UP;
+        if (dRow > 0) return DOWN;
+        return dCol < 0 ? LEFT : RIGHT;
+    }
+
+    /************ setupMoveTable *********
+     Generates all possible moves that can ever be played during a game
+
+    Parameters: none
+    Returns: 
+        A MoveTable holding every move of the Shape
+    Expects: 
+        All constants must have their correct values
+    Notes:
+        Only ever evaluated at compile time, to initialize MOVE_TABLE. Moves 
+        are numbered in row-major order of their source position, and in 
+        Direction order for each source
+    *********************************/
+    template <typename Shape>
+    constexpr MoveTable<Shape> setupMoveTable()
+    {
+        using B = Board<Shape>;
+        MoveTable<Shape> table{};
+        uint8_t n = 0;
+
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            for (int c = 0; c < NUM_COLS<Shape>; c++) {
+                for (int d = 0; d < NUM_DIRECTIONS; d++) {
+                    table.ids[r][c][d] = NO_MOVE;
+                    int midR = r + DR[d],     midC = c + DC[d];
+                    int dstR = r + 2 * DR[d], dstC = c + 2 * DC[d];
+                    if (!isPlayable<Shape>(r, c) || 
+                        !isPlayable<Shape>(midR, midC) ||
+                        !isPlayable<Shape>(dstR, dstC)) continue;
+
+                    table.masks[n].setBit = B(1) << bitIndex<Shape>(dstR, dstC);
+                    table.masks[n].clearBits = 
+                                        (B(1) << bitIndex<Shape>(r, c)) |
+                                        (B(1) << bitIndex<Shape>(midR, midC));
+                    table.coords[n] = { uint8_t(r), uint8_t(c), uint8_t(d) };
+                    table.ids[r][c][d] = n++;
+                }
+            }
+        }
+
+        for (int t = 0; t < NUM_ROTATIONS; t++) {
+            for (int i = 0; i < n; i++) {
+                const MoveCoords &m = table.coords[i];
+                int srcR = 0, srcC = 0, dstR = 0, dstC = 0;
+                transformCell(NUM_ROWS<Shape>, t, m.srcRow, m.srcCol, 
+                              srcR, srcC);
+                transformCell(NUM_ROWS<Shape>, t, m.srcRow + 2 * DR[m.dir],
+                              m.srcCol + 2 * DC[m.dir], dstR, dstC);
+                table.images[t][i] = 
+                    table.ids[srcR][srcC][directionOf(dstR - srcR, 
+                                                      dstC - srcC)];
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            const B touchedI = table.masks[i].setBit | table.masks[i].clearBits;
+            for (int j = 0; j < n; j++) {
+                const B touchedJ = table.masks[j].setBit | 
+                                   table.masks[j].clearBits;
+                if ((touchedI & touchedJ) != 0) {
+                    table.interference[i][j >> 6] |= uint64_t(1) << (j & 63);
+                }
+            }
+        }
+        return table;
+    }
+
+    /*
+      MOVE_TABLE<Shape> describes every move of the Shape. It is a constant 
+      expression, so it lives in read-only data, needs no work at startup and
+      is safe to use from other static initializers
+    */
+    template <typename Shape>
+    constexpr MoveTable<Shape> MOVE_TABLE = setupMoveTable<Shape>();
+
+    /*
+      JUMP_SOURCES<Shape>[d] has a bit set at every position a marble can 
+      jump from in Direction d. Masking a board with it before shifting keeps
+      a whole-board jump from wrapping around a row or leaving the Shape
+    */
+    template <typename Shape>
+    constexpr std::array<Board<Shape>, NUM_DIRECTIONS> jumpSources()
+    {
+        const MoveTable<Shape> &table = MOVE_TABLE<Shape>;
+        std::array<Board<Shape>, NUM_DIRECTIONS> sources{};
+        for (int i = 0; i < ShapeTraits<Shape>::NUM_MOVES; i++) {
+            const MoveCoords &m = table.coords[i];
+            sources[m.dir] |= Board<Shape>(1) << 
+                                    bitIndex<Shape>(m.srcRow, m.srcCol);
+        }
+        return sources;
+    }
+
+    template <typename Shape>
+    constexpr std::array<Board<Shape>, NUM_DIRECTIONS> JUMP_SOURCES = 
+                                                        jumpSources<Shape>();
+
+    /*************************** Merson regions *****************************/
+
+    /***** struct LockRegion *****
+     A Merson region and what is left of the Shape without it
+        Members:
+        Board region      - the positions of the region. Every move that 
+                            lands in it jumps over one of its positions, so 
+                            once it is empty no marble can ever enter it
+        Board parts[p]    - the positions outside region, split into the 
+                            parts that no move outside region connects
+        int numParts      - how many entries of parts are used
+    ******************/
+    template <typename Shape>
+    struct LockRegion {
+        Board<Shape> region;
+        Board<Shape> parts[ShapeTraits<Shape>::NUM_CELLS];
+        int numParts;
+    };
+
+    /***** struct MersonCatalogue *****
+     Every smallest Merson region of a Shape whose removal splits it
+        Members:
+        locks[i]  - the LockRegion of region i
+        count     - how many entries of locks are used
+    ******************/
+    template <typename Shape>
+    struct MersonCatalogue {
+        LockRegion<Shape> locks[ShapeTraits<Shape>::NUM_CELLS];
+        int count;
+    };
+
+    /************ setupMersonCatalogue *********
+     Finds the Merson regions worth checking during a search
+
+    Parameters: none
+    Returns: 
+        A MersonCatalogue of the Shape
+    Notes:
+        Only ever evaluated at compile time. Every Merson region is a union
+        of the smallest regions holding one position - grow {p} by the 
+        jumped-over position of every move landing in it until nothing is
+        added - so those are the only ones tried. A region is kept if the 
+        positions outside it fall apart into 2 or more parts
+    *********************************/
+    template <typename Shape>
+    constexpr MersonCatalogue<Shape> setupMersonCatalogue()
+    {
+        using B = Board<Shape>;
+        constexpr int MOVES = ShapeTraits<Shape>::NUM_MOVES;
+        constexpr int BITS = sizeof(B) * 8;
+        const MoveTable<Shape> &table = MOVE_TABLE<Shape>;
+        MersonCatalogue<Shape> catalogue{};
+        B over[MOVES] = {};
+        unsigned cells[MOVES][3] = {};
+
+        for (int i = 0; i < MOVES; i++) {
+            const MoveCoords &m = table.coords[i];
+            cells[i][0] = bitIndex<Shape>(m.srcRow, m.srcCol);
+            cells[i][1] = bitIndex<Shape>(m.srcRow + DR[m.dir], 
+                                          m.srcCol + DC[m.dir]);
+            cells[i][2] = bitIndex<Shape>(m.srcRow + 2 * DR[m.dir], 
+                                          m.srcCol + 2 * DC[m.dir]);
+            over[i] = B(1) << cells[i][1];
+        }
+
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            for (int c = 0; c < NUM_COLS<Shape>; c++) {
+                if (!Shape::PLAYABLE[r][c]) continue;
+
+                B region = B(1) << bitIndex<Shape>(r, c);
+                for (B grown = 0; grown != region; ) {
+                    grown = region;
+                    for (int i = 0; i < MOVES; i++) {
+                        if (region & table.masks[i].setBit) region |= over[i];
+                    }
+                }
+
+                bool seen = false;
+                for (int k = 0; k < catalogue.count; k++) {
+                    seen |= catalogue.locks[k].region == region;
+                }
+                if (seen) continue;
+
+                // union-find over bit indices, joined by the moves left
+                int parent[BITS] = {};
+                for (int b = 0; b < BITS; b++) parent[b] = b;
+                auto find = [&parent](int b) {
+                    while (parent[b] != b) b = parent[b];
+                    return b;
+                };
+                for (int i = 0; i < MOVES; i++) {
+                    if (region & (table.masks[i].setBit | 
+                                  table.masks[i].clearBits)) continue;
+                    parent[find(cells[i][0])] = find(cells[i][1]);
+                    parent[find(cells[i][1])] = find(cells[i][2]);
+                }
+
+                LockRegion<Shape> lock{};
+                lock.region = region;
+                B rest = FULL_BOARD<Shape> & ~region;
+                for (int b = 0; b < BITS; b++) {
+                    if (!((rest >> b) & 1) || find(b) != b) continue;
+                    for (int o = 0; o < BITS; o++) {
+                        if (((rest >> o) & 1) && find(o) == b) 
+                            lock.parts[lock.numParts] |= B(1) << o;
+                    }
+                    lock.numParts++;
+                }
+                if (lock.numParts >= 2) catalogue.locks[catalogue.count++] = lock;
+            }
+        }
+        return catalogue;
+    }
+
+    template <typename Shape>
+    constexpr MersonCatalogue<Shape> MERSON_CATALOGUE = 
+                                            setupMersonCatalogue<Shape>();
+
+    /************ step *********
+     Moves every marble of a board one position in a Direction
+
+    Parameters:
+        Board b     - the board to move
+        int d       - the Direction to move it in
+    Returns: 
+        A Board - b with every bit moved one position over
+    Notes:
+        Bits are not kept on the Shape - mask b with JUMP_SOURCES first
+    *********************************/
+    template <typename Shape>
+    inline Board<Shape> step(Board<Shape> b, int d)
+    {
+        switch (d) {
+            case UP:   return b << NUM_COLS<Shape>;
+            case DOWN: return b >> NUM_COLS<Shape>;
+            case LEFT: return b << 1;
+            default:   return b >> 1;
+        }
+    }
+
      /************ inverseTransform *********
      Takes in a Transform and returns the inverse of that Transform
     
@@ -390,82 +1188,446 @@ namespace {
     Returns: 
         An msBoard::Transform - the inverse of the provided transform
     *********************************/ 
-    inline msBoard::Transform inverseTransform(msBoard::Transform t) {
-        switch(t){
-            case msBoard::DEGREE_0:   return msBoard::DEGREE_0;
-            case msBoard::DEGREE_90:  return msBoard::DEGREE_270;
-            case msBoard::DEGREE_180: return msBoard::DEGREE_180;
-            case msBoard::DEGREE_270: return msBoard::DEGREE_90;
-            case msBoard::FLIP_H:     return msBoard::FLIP_H;
-            case msBoard::FLIP_V:     return msBoard::FLIP_V;
-            case msBoard::FLIP_DIAG:  return msBoard::FLIP_DIAG;
-            case msBoard::FLIP_ANTI:  return msBoard::FLIP_ANTI;
+    template <typename Shape>
+    inline typename msBasicBoard<Shape>::Transform 
+                    inverseTransform(typename msBasicBoard<Shape>::Transform t) {
+        return typename msBasicBoard<Shape>::Transform(D4_INVERSE[t]);
+    }
+
+    /************ pickCanonical *********
+     Picks the smallest of a board's images, and finds its stabilizer
+
+    Parameters: 
+        const Word images[8] - images[t] is Transform t of the board, for 
+                               every t in the Shape's group (the rest are 
+                               never read)
+        uint8_t *stabilizer  - as in getCanonicalBits
+    Returns: 
+        The smallest image, and the Transform that gives it (the lowest one,
+        if several do)
+    Notes:
+        Word is a Board, or a board in the padded layout - both order boards
+        the same way
+    *********************************/
+    template <typename Shape, typename Word>
+    inline std::pair<Word, uint8_t> pickCanonical(const Word images[],
+                                                  uint8_t *stabilizer) {
+        constexpr uint8_t GROUP = SYMMETRIES<Shape>;
+        Word best = images[0];
+        uint8_t bestTransform = 0;
+        for (int i = 0; i < NUM_ROTATIONS; i++) {
+            if (!(GROUP & (1 << i))) continue;
+            if (images[i] < best) {
+                best = images[i];
+                bestTransform = uint8_t(i);
+            }
+        }
+
+        /*
+          Every t with images[t] == best is bestTransform after a symmetry g of 
+          the original board, so undoing bestTransform and then applying t is a
+          symmetry of best - and every symmetry of best is found this way
+        */
+        if (stabilizer) {
+            const uint8_t undo = D4_INVERSE[bestTransform];
+            uint8_t group = 0;
+            for (int i = 0; i < NUM_ROTATIONS; i++) {
+                if ((GROUP & (1 << i)) && images[i] == best)
+                    group |= uint8_t(1 << D4_COMPOSE[undo][i]);
+            }
+            *stabilizer = group;
         }
-        return msBoard::DEGREE_0; // unreachable
+
+        return { best, bestTransform };
     }
 
-}
-/*********************** Private Member Functions *****************************/
-/************ setupAllMoves *********
- Generates all possible moves that can ever be played during a game
+    /************ canonicalBits *********
+     The body of getCanonicalBits, compiled once with pext and once without.
+     Shapes with the padded layout (see PADDED_OK) build their images there,
+     wider ones row by row
 
-Parameters: none
-Returns: 
-    vector<Move> containing all the possible moves
-Expects: 
-    All constants must have their correct values
-Notes:
-    Will not throw any errors
-*********************************/
-std::vector<msBoard::Move> msBoard::setupAllMoves()  
-{
-    std::vector<msBoard::Move> moves;
+    Parameters: 
+        Board b             - the board to canonicalize
+        uint8_t *stabilizer - as in getCanonicalBits
+    Returns: 
+        The canonical board, and the Transform that turns b into it
+    Notes:
+        PEXT may only be true inside a PEXT_TARGET function (see 
+        canonicalBitsPext)
+    *********************************/
+    template <typename Shape, bool PEXT>
+    inline std::pair<Board<Shape>, uint8_t> canonicalBits(Board<Shape> board,
+                                                    uint8_t *stabilizer) {
+        if constexpr (ENABLE_PADDED_SYMMETRIES && PADDED_OK<Shape>) {
+            uint64_t images[NUM_ROTATIONS];
+            paddedImages<Shape>(toPadded<Shape, PEXT>(board), images);
+            auto [best, t] = pickCanonical<Shape>(images, stabilizer);
+            return { fromPadded<Shape, PEXT>(best), t };
+        }
 
-    for (int r = 0; r < NUM_ROWS; r++) {
-        for (int c = COL_START_IDX[r]; c <= COL_END_IDX[r]; c++) {
-            if (!PLAYABLE[r][c]) continue;
+        using msBoard = msBasicBoard<Shape>;
+        using B = Board<Shape>;
+        constexpr uint8_t GROUP = SYMMETRIES<Shape>;
+        constexpr int R90 = msBoard::DEGREE_90, R180 = msBoard::DEGREE_180,
+                      R270 = msBoard::DEGREE_270, FH = msBoard::FLIP_H,
+                      FV = msBoard::FLIP_V, FD = msBoard::FLIP_DIAG,
+                      FA = msBoard::FLIP_ANTI;
+        constexpr uint8_t NEEDS_COLS = (1 << R90) | (1 << R270) |
+                                       (1 << FD) | (1 << FA);
+        constexpr int LAST = MAX_ROW<Shape>;
+        constexpr auto &SHIFT = rowShift<Shape>;
+        const ReversedTable<Shape> &REV = REVERSED<Shape>;
+        B boards[NUM_ROTATIONS] = { board };
 
-            unsigned src = bitIndex(r, c);
+        /*
+          Yes, calling transformBoard is more modular, but performance is 
+          essential - boards[t] must equal transformBoard(board, t). GROUP is
+          a constant, so the transforms the Shape doesn't have are folded 
+          away entirely
+        */
+        for (int i = 0; i < NUM_ROWS<Shape>; i++) {
+            Row<Shape> row = getRow<Shape>(board, i);
+            Column<Shape> col = (GROUP & NEEDS_COLS) ? 
+                                        getCol<Shape, PEXT>(board, i) : 0;
+
+            if (GROUP & (1 << R90))
+                boards[R90]  |= B(col)      << SHIFT[LAST - i];
+            if (GROUP & (1 << R180))
+                boards[R180] |= B(REV[row]) << SHIFT[LAST - i];
+            if (GROUP & (1 << R270))
+                boards[R270] |= B(REV[col]) << SHIFT[i];
+            if (GROUP & (1 << FH))
+                boards[FH]   |= B(REV[row]) << SHIFT[i];
+            if (GROUP & (1 << FV))
+                boards[FV]   |= B(row)      << SHIFT[LAST - i];
+            if (GROUP & (1 << FD))
+                boards[FD]   |= B(col)      << SHIFT[i];
+            if (GROUP & (1 << FA))
+                boards[FA]   |= B(REV[col]) << SHIFT[LAST - i];
+        }
 
-            if (r >= 2 && PLAYABLE[r-1][c] && PLAYABLE[r-2][c])
-                moves.push_back(Move(Board(1) << bitIndex(r-2, c),
-                                     (Board(1) << src) | 
-                                     (Board(1) << bitIndex(r-1, c))));
+        return pickCanonical<Shape>(boards, stabilizer);
+    }
 
-            if (r <= 4 && PLAYABLE[r+1][c] && PLAYABLE[r+2][c])
-                moves.push_back(Move(Board(1) << bitIndex(r+2, c),
-                                     (Board(1) << src) | 
-                                     (Board(1) << bitIndex(r+1, c))));
+    /************ imageRows *********
+     Builds row r of all 8 Transforms of a board, without the rest of them
 
-            if (c >= 2 && PLAYABLE[r][c-1] && PLAYABLE[r][c-2])
-                moves.push_back(Move(Board(1) << bitIndex(r, c-2),
-                                     (Board(1) << src) | 
-                                     (Board(1) << bitIndex(r, c-1))));
+    Parameters: 
+        Board b            - the board
+        int r              - the row of the transformed boards to build
+        Row rows[8]        - rows[t] is set to row r of transformBoard(b, t)
+    Notes:
+        Every one of them is row r or MAX_ROW - r, or column r or MAX_COL - r
+        of b, maybe reversed - so a row of all 8 costs 2 rows and 2 columns
+    *********************************/
+    template <typename Shape, bool PEXT>
+    inline void imageRows(Board<Shape> b, int r, Row<Shape> rows[]) {
+        using msBoard = msBasicBoard<Shape>;
+        constexpr int LAST = MAX_ROW<Shape>;
+        const ReversedTable<Shape> &REV = REVERSED<Shape>;
+        const Row<Shape> top = getRow<Shape>(b, r);
+        const Row<Shape> bottom = getRow<Shape>(b, LAST - r);
+        const Column<Shape> left = getCol<Shape, PEXT>(b, r);
+        const Column<Shape> right = getCol<Shape, PEXT>(b, LAST - r);
+
+        rows[msBoard::DEGREE_0]   = top;
+        rows[msBoard::DEGREE_90]  = right;
+        rows[msBoard::DEGREE_180] = REV[bottom];
+        rows[msBoard::DEGREE_270] = REV[left];
+        rows[msBoard::FLIP_H]     = REV[top];
+        rows[msBoard::FLIP_V]     = bottom;
+        rows[msBoard::FLIP_DIAG]  = left;
+        rows[msBoard::FLIP_ANTI]  = REV[right];
+    }
 
-            if (c <= 4 && PLAYABLE[r][c+1] && PLAYABLE[r][c+2])
-                moves.push_back(Move(Board(1) << bitIndex(r, c+2),
-                                     (Board(1) << src) | 
-                                     (Board(1) << bitIndex(r, c+1))));
+    /************ canonicalBitsLazy *********
+     Like canonicalBits, but builds the images a row at a time from the top 
+     (most significant) row down, and drops every image whose rows so far 
+     are larger than the smallest's. It stops as soon as one image is left,
+     and only that one is built in full
+
+    Parameters: 
+        Board b             - the board to canonicalize
+        uint8_t *stabilizer - as in getCanonicalBits
+        int *rowsCompared   - if not nullptr, set to the number of rows
+                              built before one image was left (NUM_ROWS if
+                              several images are equal)
+    Returns: 
+        Exactly what canonicalBits returns
+    Notes:
+        Images that tie on every row are the board's symmetries - they all
+        stay to the end, and the lowest Transform wins, as in pickCanonical
+    *********************************/
+    template <typename Shape, bool PEXT>
+    inline std::pair<Board<Shape>, uint8_t> canonicalBitsLazy(
+                Board<Shape> board, uint8_t *stabilizer, int *rowsCompared) {
+        using msBoard = msBasicBoard<Shape>;
+        uint8_t alive = SYMMETRIES<Shape>;
+        int r = 0;
+
+        /*
+          All 8 rows are built and compared every time, with the dropped 
+          images masked out - looping over only the live ones costs more in
+          mispredicted branches than it saves
+        */
+        for (; r < NUM_ROWS<Shape> && (alive & (alive - 1)); r++) {
+            Row<Shape> rows[NUM_ROTATIONS];
+            imageRows<Shape, PEXT>(board, r, rows);
+            Row<Shape> smallest = LINE_MASK<Shape>;
+            for (int t = 0; t < NUM_ROTATIONS; t++) {
+                const Row<Shape> row = ((alive >> t) & 1) ? rows[t] 
+                                                          : LINE_MASK<Shape>;
+                smallest = std::min(smallest, row);
+            }
+            uint8_t tied = 0;
+            for (int t = 0; t < NUM_ROTATIONS; t++)
+                tied |= uint8_t((rows[t] == smallest) << t);
+            alive &= tied;
+        }
+
+        const uint8_t best = uint8_t(__builtin_ctz(alive));
+        if (stabilizer) {
+            const uint8_t undo = D4_INVERSE[best];
+            uint8_t group = 0;
+            for (unsigned left = alive; left; left &= left - 1)
+                group |= uint8_t(1 << D4_COMPOSE[undo][__builtin_ctz(left)]);
+            *stabilizer = group;
         }
+        if (rowsCompared) *rowsCompared = r;
+
+        return { transformBoard<Shape>(board, 
+                                       typename msBoard::Transform(best)), 
+                 best };
     }
 
-    return moves;
-}
+    /************ packBits *********
+     The body of boardToBits, compiled once with pext and once without
+
+    Parameters: 
+        T board - the board to pack, or a Lanes of 64 bit boards
+    Returns: 
+        A uint64_t - the packed board, as boardToBits returns it (or a 
+        Lanes of them)
+    Notes:
+        PEXT may only be true inside a PEXT_TARGET function (see 
+        packBitsPext)
+    *********************************/
+    template <typename Shape, bool PEXT, typename T = Board<Shape>>
+    inline auto packBits(T board) {
+        using Key = std::conditional_t<std::is_same_v<T, Board<Shape>>, 
+                                       uint64_t, T>;
+       #if HAVE_PEXT
+        if constexpr (PEXT && sizeof(Board<Shape>) == sizeof(uint64_t)) {
+            return pext64(board, FULL_BOARD<Shape>);
+        }
+       #endif
+        Key ret = Key{};
+        /*
+          - Shift the row's playable run down to the LSB
+          - Append it to the LSB-side of ret, so row 0 ends up most significant
+          - Repeat for each row
+          This gives us all the bits of the playable boardspace. The bounds are
+          constants, so the loop unrolls into a handful of shifts and masks
+        */
+        for (int r = 0; r < NUM_ROWS<Shape>; r++) {
+            const int len = COL_END_IDX<Shape>[r] - COL_START_IDX<Shape>[r] + 1;
+            if (len <= 0) continue;
+            const unsigned low = bitIndex<Shape>(r, COL_END_IDX<Shape>[r]);
+            ret = (ret << len) | 
+                  (Key(board >> low) & ((uint64_t(1) << len) - 1));
+        }
+        return ret;
+    }
+
+    /************ Lanes *********
+     LANES 64 bit boards handled side by side in one vector (a GCC / Clang
+     vector extension type) - every operator works on each lane separately,
+     as one SSE2 / NEON, AVX2 or AVX-512 instruction, whatever the function 
+     it is inlined into is compiled for. The padded layout kernels take a 
+     Lanes wherever they take a uint64_t
 
+    Members:
+        Vec v - the boards, one per lane
+    Notes:
+        Vec is only 8 byte aligned, so Lanes are passed in memory - a 32 or
+        64 byte aligned vector would be passed in a register whose ABI 
+        depends on the target, which GCC warns about (-Wpsabi)
+    *********************************/
+    template <int LANES> struct LaneVec;
+    template <> struct LaneVec<2> {
+        typedef uint64_t Vec __attribute__((vector_size(16), aligned(8)));
+    };
+    template <> struct LaneVec<4> {
+        typedef uint64_t Vec __attribute__((vector_size(32), aligned(8)));
+    };
+    template <> struct LaneVec<8> {
+        typedef uint64_t Vec __attribute__((vector_size(64), aligned(8)));
+    };
+
+    template <int LANES>
+    struct Lanes {
+        using Vec = typename LaneVec<LANES>::Vec;
+        Vec v;
+
+        Lanes &operator&=(const Lanes &o) { v &= o.v; return *this; }
+        Lanes &operator|=(const Lanes &o) { v |= o.v; return *this; }
+        Lanes &operator^=(const Lanes &o) { v ^= o.v; return *this; }
+        Lanes &operator&=(uint64_t mask) { v &= mask; return *this; }
+        Lanes &operator>>=(int shift) { v >>= shift; return *this; }
+        Lanes &operator<<=(int shift) { v <<= shift; return *this; }
+
+        friend Lanes operator&(Lanes a, const Lanes &b) { return a &= b; }
+        friend Lanes operator|(Lanes a, const Lanes &b) { return a |= b; }
+        friend Lanes operator^(Lanes a, const Lanes &b) { return a ^= b; }
+        friend Lanes operator&(Lanes a, uint64_t mask) { return a &= mask; }
+        friend Lanes operator&(uint64_t mask, Lanes a) { return a &= mask; }
+        friend Lanes operator>>(Lanes a, int shift) { return a >>= shift; }
+        friend Lanes operator<<(Lanes a, int shift) { return a <<= shift; }
+    };
+
+    /************ canonicalKeysLanes *********
+     The body of msBoard::canonicalKeys - canonicalizes LANES boards at a 
+     time, side by side in a Lanes, and writes out each one's key (the 
+     boardToBits of its canonical board) and Transform
+
+    Parameters: 
+        const uint64_t *boards - the boards
+        size_t count           - how many there are
+        uint64_t *keys         - keys[i] is set to the key of boards[i]
+        Transform *transforms  - transforms[i] is set to the Transform that
+                                 turns boards[i] into its canonical board
+    Expects:
+        PADDED_OK<Shape>
+    Notes:
+        Every step in the padded layout is a shift, mask or xor, so the 
+        whole kernel runs lane by lane without a branch. It is compiled with
+        LANES = 8 for AVX-512 and 4 for AVX2 (see AVX512_TARGET),
+        and 2 everywhere else. Ties go to the lowest Transform, as in 
+        pickCanonical. The last count % LANES boards go through 
+        canonicalBits one at a time
+    *********************************/
+    template <typename Shape, int LANES>
+    inline void canonicalKeysLanes(const uint64_t *boards, size_t count,
+                                   uint64_t *keys, 
+                        typename msBasicBoard<Shape>::Transform *transforms) {
+        using Transform = typename msBasicBoard<Shape>::Transform;
+        using L = Lanes<LANES>;
+        constexpr uint8_t GROUP = SYMMETRIES<Shape>;
+        size_t i = 0;
+
+        for (; i + LANES <= count; i += LANES) {
+            L board;
+            std::memcpy(&board.v, boards + i, sizeof board.v);
+            L images[NUM_ROTATIONS];
+            paddedImages<Shape>(toPadded<Shape>(board), images);
+
+            typename L::Vec best = images[0].v;
+            typename L::Vec bestTransform = {};
+            for (int t = 1; t < NUM_ROTATIONS; t++) {
+                if (!(GROUP & (1 << t))) continue;
+                const typename L::Vec transform = typename L::Vec{} + 
+                                                  uint64_t(t);
+                const auto smaller = images[t].v < best;
+                best = smaller ? images[t].v : best;
+                bestTransform = smaller ? transform : bestTransform;
+            }
+
+            const L key = packBits<Shape, false>(fromPadded<Shape>(L{best}));
+            std::memcpy(keys + i, &key.v, sizeof key.v);
+            for (int lane = 0; lane < LANES; lane++)
+                transforms[i + lane] = Transform(bestTransform[lane]);
+        }
+
+        for (; i < count; i++) {
+            auto [best, t] = canonicalBits<Shape, false>(boards[i], nullptr);
+            keys[i] = packBits<Shape, false>(best);
+            transforms[i] = Transform(t);
+        }
+    }
+
+#if HAVE_PEXT
+    /*
+      The pext versions of the kernels. The choose functions below pick 
+      between them and the portable ones for msCpu::Dispatch, which only
+      asks on the first call
+    */
+    template <typename Shape>
+    PEXT_TARGET std::pair<Board<Shape>, uint8_t> canonicalBitsPext(
+                                Board<Shape> board, uint8_t *stabilizer) {
+        return canonicalBits<Shape, true>(board, stabilizer);
+    }
+
+    template <typename Shape>
+    PEXT_TARGET std::pair<Board<Shape>, uint8_t> canonicalBitsLazyPext(
+            Board<Shape> board, uint8_t *stabilizer, int *rowsCompared) {
+        return canonicalBitsLazy<Shape, true>(board, stabilizer, 
+                                              rowsCompared);
+    }
+
+    template <typename Shape>
+    PEXT_TARGET uint64_t packBitsPext(Board<Shape> board) {
+        return packBits<Shape, true>(board);
+    }
+
+    template <typename Shape>
+    auto chooseCanonicalBits() {
+        return msCpu::features().fastPext ? &canonicalBitsPext<Shape> 
+                                          : &canonicalBits<Shape, false>;
+    }
+
+    template <typename Shape>
+    auto chooseCanonicalBitsLazy() {
+        return msCpu::features().fastPext ? &canonicalBitsLazyPext<Shape>
+                                          : &canonicalBitsLazy<Shape, false>;
+    }
+
+    template <typename Shape>
+    auto choosePackBits() {
+        return msCpu::features().fastPext ? &packBitsPext<Shape> 
+                                          : &packBits<Shape, false>;
+    }
+#endif
+
+#if HAVE_SIMD_DISPATCH
+    template <typename Shape>
+    AVX512_TARGET void canonicalKeysAvx512(const uint64_t *boards, 
+                size_t count, uint64_t *keys, 
+                typename msBasicBoard<Shape>::Transform *transforms) {
+        canonicalKeysLanes<Shape, 8>(boards, count, keys, transforms);
+    }
+
+    template <typename Shape>
+    AVX2_TARGET void canonicalKeysAvx2(const uint64_t *boards, 
+                size_t count, uint64_t *keys, 
+                typename msBasicBoard<Shape>::Transform *transforms) {
+        canonicalKeysLanes<Shape, 4>(boards, count, keys, transforms);
+    }
+
+    // the kernel for the widest vectors this cpu has, for msCpu::Dispatch
+    template <typename Shape>
+    auto chooseCanonicalKeys() {
+        if (msCpu::features().avx512) return &canonicalKeysAvx512<Shape>;
+        if (msCpu::features().avx2) return &canonicalKeysAvx2<Shape>;
+        return &canonicalKeysLanes<Shape, 2>;
+    }
+#endif
+
+}
 /**************************** msBoard public functions ************************/
 
 
 /************ msBoard - public default constructor *********
  Constructor for msBoard class - uses the DEFAULT board that has the open
- marble spot as the top left position (0, 2)
+ marble spot at the Shape's default empty position (0, 2 for French boards)
 
 Parameters: none
 Returns: 
     An instance of the msBoard class
 *********************************/
-msBoard::msBoard()
+template <typename Shape>
+msBasicBoard<Shape>::msBasicBoard()
 {
-    board = DEFAULT_BOARD;
+    board = DEFAULT_BOARD<Shape>;
 }
 /************ msBoard - public custom constructor *********
  Constructor for msBoard class - users can choose which position of the board
@@ -479,13 +1641,14 @@ Returns:
 Notes:
     Will use the DEFAULT board if the row or col is out of bounds
 *********************************/
-msBoard::msBoard(unsigned row, unsigned col) 
+template <typename Shape>
+msBasicBoard<Shape>::msBasicBoard(unsigned row, unsigned col) 
 {
-    if (row > MAX_ROW || col > MAX_COL || !PLAYABLE[row][col]) {
-        board = DEFAULT_BOARD;
+    if (row > MAX_ROW<Shape> || col > MAX_COL<Shape> || !Shape::PLAYABLE[row][col]) {
+        board = DEFAULT_BOARD<Shape>;
     } else {
-        board = FULL_BOARD;
-        Board mask = Board(1) << (bitIndex(row, col));
+        board = FULL_BOARD<Shape>;
+        Board mask = Board(1) << (bitIndex<Shape>(row, col));
         board &= ~mask;
     }
 }
@@ -503,35 +1666,212 @@ Expects:
 Notes:
     Will not throw any errors
 *********************************/
-bool msBoard::hasWon() const 
+template <typename Shape>
+bool msBasicBoard<Shape>::hasWon() const 
+{
+    return popcount(board) == WINNING_MARBLE_COUNT;
+}
+
+/************ numMarbles *********
+ Counts the marbles on the board
+
+Parameters: none
+Returns: 
+    An int - the number of playable positions that contain a marble
+*********************************/
+template <typename Shape>
+int msBasicBoard<Shape>::numMarbles() const 
 {
-    return __builtin_popcountll(board) == WINNING_MARBLE_COUNT;
+    return popcount(board);
+}
+
+/************ numDeadMarbles *********
+ Counts the marbles that can never move or be jumped over again, however the
+ game goes on
+
+Parameters: none
+Returns: 
+    An int - the number of dead marbles. A board with 2 or more of them can 
+             never be won
+Expects: 
+    board satisfies the Board invariants
+Notes:
+    First finds every position that could ever hold a marble again: the 
+    marbles themselves, then every position some jump between two of those
+    lands on, and so on until nothing is added. Whether the landing spot 
+    is empty is ignored, so this only over-estimates. A marble is dead if 
+    no such position is next to it in line with a position it could jump 
+    to, or behind it for a marble that could jump over it
+*********************************/
+template <typename Shape>
+int msBasicBoard<Shape>::numDeadMarbles() const 
+{
+    TRACE_SCOPE(DEAD_MARBLES);
+    const auto &SOURCES = JUMP_SOURCES<Shape>;
+    Board reach = board;
+    Board grown = board;
+
+    do {
+        reach = grown;
+        for (int d = 0; d < NUM_DIRECTIONS; d++) {
+            Board over = step<Shape>(reach & SOURCES[d], d) & reach;
+            grown |= step<Shape>(over, d);
+        }
+    } while (grown != reach);
+
+    /*
+      d ^ 1 is the opposite Direction of d - a marble can jump in direction
+      d if the position next to it in direction d can hold a marble
+    */
+    Board live = 0;
+    for (int d = 0; d < NUM_DIRECTIONS; d++) {
+        live |= step<Shape>(reach & SOURCES[d], d);
+        live |= SOURCES[d] & step<Shape>(reach, d ^ 1);
+    }
+    return popcount(board & ~live);
+}
+
+/************ isSplitByMersonRegion *********
+ Checks whether an empty Merson region keeps the marbles apart for good
+
+Parameters: none
+Returns: 
+    A bool - true if some region of MERSON_CATALOGUE is empty and marbles
+             are left in 2 or more of the parts outside it. Such a board can 
+             never be won
+Expects: 
+    board satisfies the Board invariants
+Notes:
+    An empty Merson region stays empty, so every later move stays inside
+    one part, and every part that holds a marble always will
+*********************************/
+template <typename Shape>
+bool msBasicBoard<Shape>::isSplitByMersonRegion() const 
+{
+    const MersonCatalogue<Shape> &catalogue = MERSON_CATALOGUE<Shape>;
+    for (int i = 0; i < catalogue.count; i++) {
+        const LockRegion<Shape> &lock = catalogue.locks[i];
+        if (board & lock.region) continue;
+
+        int occupied = 0;
+        for (int p = 0; p < lock.numParts; p++) {
+            occupied += (board & lock.parts[p]) != 0;
+        }
+        if (occupied >= 2) return true;
+    }
+    return false;
 }
 
 /************ validMoves *********
- Appends all possible valid moves on the given board to the given vector
+ Fills the given MoveList with all possible valid moves on the board
 
 Parameters:
-    Board board - the board to be analyzed, passed by reference
-    vector<const Move*> &moves - a reference to a vector of Move 
-                                    pointers to be appended with all current
-                                    valid moves on the given board
+    MoveList &moves - a reference to the MoveList to be filled with all 
+                      current valid moves on the board
 Returns: void
 Expects: 
     board satisfies the Board invariants
 Notes:
-    Appends (does not clear) valid moves for this board to moves
+    Replaces whatever moves was holding. Moves come out in move table order
 *********************************/
-void msBoard::validMoves(std::vector<msBoard::Move> &moves) const 
+template <typename Shape>
+void msBasicBoard<Shape>::validMoves(MoveList &moves) const 
 {
+    TRACE_SCOPE(VALID_MOVES);
+    const auto &masks = MOVE_TABLE<Shape>.masks;
     const Board occupied = board;
     const Board empty = ~board;
+    size_t count = 0;
     
-    for (const Move& m : ALL_MOVES) {
-        const bool valid = ((occupied & m.clearBits) == m.clearBits) & 
-                          ((empty & m.setBit) == m.setBit);
-        if (valid) moves.push_back(m);
+    /*
+      Every move is written, but only kept (by bumping count) if it is valid 
+      - there is always room, since count never passes the index i
+    */
+    for (int i = 0; i < NUM_MOVES; i++) {
+        const bool valid = 
+                    ((occupied & masks[i].clearBits) == masks[i].clearBits) & 
+                    ((empty & masks[i].setBit) == masks[i].setBit);
+        moves.items[count] = Move(uint8_t(i));
+        count += valid;
     }
+    moves.count = count;
+}
+
+/************ validUndoMoves *********
+ Fills the given MoveList with every move that could have led to the board
+ - the moves whose undoMove is legal here
+
+Parameters:
+    MoveList &moves - a reference to the MoveList to be filled with every
+                      move m such that undoMove(m) is a board on which m is
+                      valid, and applying m to it gives back this board
+Returns: void
+Expects: 
+    board satisfies the Board invariants
+Notes:
+    The mirror image of validMoves: a move could have been the last one iff
+    the position it lands on holds a marble and the two it clears are 
+    empty. Replaces whatever moves was holding. Moves come out in move table
+    order
+*********************************/
+template <typename Shape>
+void msBasicBoard<Shape>::validUndoMoves(MoveList &moves) const 
+{
+    const auto &masks = MOVE_TABLE<Shape>.masks;
+    const Board occupied = board;
+    const Board empty = ~board;
+    size_t count = 0;
+
+    for (int i = 0; i < NUM_MOVES; i++) {
+        const bool valid = 
+                    ((empty & masks[i].clearBits) == masks[i].clearBits) & 
+                    ((occupied & masks[i].setBit) == masks[i].setBit);
+        moves.items[count] = Move(uint8_t(i));
+        count += valid;
+    }
+    moves.count = count;
+}
+
+/************ validMoves *********
+ Fills the given MoveList with one valid move out of every set of valid 
+ moves that the board's symmetries map onto each other
+
+Parameters:
+    MoveList &moves    - a reference to the MoveList to be filled
+    uint8_t stabilizer - bit t is set iff Transform t maps the board onto 
+                         itself, as reported by getCanonicalBits
+Returns: void
+Expects: 
+    board satisfies the Board invariants
+    stabilizer is exactly the board's symmetry group
+Notes:
+    Moves that a symmetry of the board maps onto each other lead to boards
+    with the same canonical form, so only the one with the smallest move 
+    table index is kept. Boards with no symmetry but DEGREE_0 get every 
+    valid move
+*********************************/
+template <typename Shape>
+void msBasicBoard<Shape>::validMoves(MoveList &moves, 
+                                     uint8_t stabilizer) const 
+{
+    validMoves(moves);
+    const uint8_t others = stabilizer & ~uint8_t(1 << DEGREE_0);
+    if (!others) return;
+
+    // validMoves above traced the generation - this is only the filtering
+    TRACE_SCOPE(SYMMETRY_FILTER);
+    const auto &images = MOVE_TABLE<Shape>.images;
+    size_t count = 0;
+    for (size_t i = 0; i < moves.count; i++) {
+        const uint8_t index = moves.items[i].index;
+        bool smallest = true;
+        for (int t = 1; t < NUM_ROTATIONS; t++) {
+            if (others & (1 << t)) smallest &= images[t][index] >= index;
+        }
+        moves.items[count] = moves.items[i];
+        count += smallest;
+    }
+    moves.count = count;
 }
 
 /************ applyMove *********
@@ -548,51 +1888,43 @@ Expects:
 Notes:
 
 *********************************/
- msBoard msBoard::applyMove(const msBoard::Move m) const 
- {
-    Board next = (board | m.setBit) & ~(m.clearBits);
-    return msBoard(next);
+template <typename Shape>
+msBasicBoard<Shape> msBasicBoard<Shape>::applyMove(const Move m) const 
+{
+    TRACE_SCOPE(APPLY_MOVE);
+    const MoveMasks<Shape> &mask = MOVE_TABLE<Shape>.masks[m.index];
+    Board next = (board | mask.setBit) & ~(mask.clearBits);
+    return msBasicBoard(next);
 }
 
 /************ boardToBits *********
- Converts a board to its minimum representation of just 37 bits - each unique 
- board will correspond exactly one output of this function
+ Converts a board to its minimum representation of just NUM_CELLS bits (37 
+ for French boards) - each unique board will correspond exactly one output of
+ this function
 
 Parameters: none
 Returns: 
-    A uint64_t - the least significant 37 bits contain a packed version of the
-                 board - exact structure is not relevant
+    A uint64_t - the least significant NUM_CELLS bits contain a packed version
+                 of the board - exact structure is not relevant
 Notes:
     This is not designed for board representation but rather a way to map every
-    possible board to a single representation of 37 bits
+    possible board to a single representation of NUM_CELLS bits
 *********************************/
-uint64_t msBoard::boardToBits() const 
+template <typename Shape>
+uint64_t msBasicBoard<Shape>::boardToBits() const 
 {
-        Board ret = EMPTY_BOARD;
-        Board b = board;
-        /*
-          - Shift b by however many bits until end of row
-          - Add however many bits that row has to MSB-side of ret
-          - Repeat for each row
-          This gives us all the bits of the playable boardspace
-        */
-        b >>= 17;
-        ret |= (b & 0x7); // ret has 3 bits
-        b >>= 6;
-        ret |= (b & 0x1F) << 3; // ret has 8 bits
-        b >>= 6;
-        ret |= (b & 0x1FFFFF) << 8; // ret has 29 bits
-        b >>= 22;
-        ret |= (b & 0x1F) << 29; // ret has 34 bits
-        b >>= 8;
-        ret |= (b & 0x7) << 34; // ret has 37 bits
-
-        return ret;
+    #if HAVE_PEXT
+        if constexpr (sizeof(Board) == sizeof(uint64_t)) {
+            return msCpu::Dispatch<choosePackBits<Shape>>::call(board);
+        }
+    #endif
+    return packBits<Shape, false>(board);
 }
 
 
 /****************** printBoard ********************
- Prints an msboard as a 7x7 grid of 1s and 0s 
+ Prints an msboard as a grid of 1s and 0s, with column numbers above it and
+ row numbers beside it
     1 = marble
     0 = empty
 Parameters: none
@@ -600,17 +1932,18 @@ Returns: void
 Notes:
     Outputs to stdout
 ***************************************************/
-void msBoard::printBoard(std::ostream &stream) const 
+template <typename Shape>
+void msBasicBoard<Shape>::printBoard(std::ostream &stream) const 
 {
-    stream << "   " << 0 << " " << 1 << " " << 2 << " " << 3 << " " << 4 
-              << " " << 5 << " " << 6 << '\n';
-    for (int r = 0; r < NUM_ROWS; r++) {
+    stream << "  ";
+    for (int c = 0; c < NUM_COLS<Shape>; c++) stream << " " << c;
+    stream << '\n';
+    for (int r = 0; r < NUM_ROWS<Shape>; r++) {
         stream << r << "  ";
-        if (r == 0 || r == 6) stream << "    ";
-        if (r == 1 || r == 5) stream << "  ";
-        for (int c = COL_START_IDX[r]; c <= COL_END_IDX[r]; c++) {
-            stream << TO_STRING(getBit(board, r, c));
-            if (c < COL_END_IDX[r]) stream << " ";
+        for (int c = 0; c < COL_START_IDX<Shape>[r]; c++) stream << "  ";
+        for (int c = COL_START_IDX<Shape>[r]; c <= COL_END_IDX<Shape>[r]; c++) {
+            stream << TO_STRING(getBit<Shape>(board, r, c));
+            if (c < COL_END_IDX<Shape>[r]) stream << " ";
         }
         stream << "\n";
     }
@@ -629,7 +1962,8 @@ Notes:
     Will NOT CRE if b is structured poorly, but will exhibit undefined 
     behavior once other methods are called with this instance
 *********************************/
-msBoard::msBoard(Board b) 
+template <typename Shape>
+msBasicBoard<Shape>::msBasicBoard(Board b) 
 {
     board = b;
 }
@@ -639,43 +1973,113 @@ msBoard::msBoard(Board b)
     rotations are considered
 
 Parameters: 
-    Board b - the board that we analyze, passed by value
+    uint8_t *stabilizer - if not nullptr, set to the symmetry group of the 
+                          canonical board: bit t is set iff Transform t maps
+                          the canonical board onto itself (bit DEGREE_0 is
+                          always set)
 Returns: 
-    a Board - canonical version of the given board
+    the canonical version of the board, and the Transform that turns the 
+    board into it
 Expects: 
     b follows all Board invariants
 Notes:
     Will return ill-formatted board if b is structured improperly
 ****************************************/
-std::pair<msBoard, msBoard::Transform> msBoard::getCanonicalBits() const {
-    Board best = board;
-    Transform bestTransform = DEGREE_0;
-    Board boards[NUM_ROTATIONS] = { board, EMPTY_BOARD, EMPTY_BOARD, 
-                                    EMPTY_BOARD, EMPTY_BOARD, EMPTY_BOARD, 
-                                    EMPTY_BOARD, EMPTY_BOARD };
+template <typename Shape>
+std::pair<msBasicBoard<Shape>, typename msBasicBoard<Shape>::Transform> 
+        msBasicBoard<Shape>::getCanonicalBits(uint8_t *stabilizer) const {
+    TRACE_SCOPE(CANONICAL);
+    if constexpr (ENABLE_LAZY_CANONICAL) {
+        return getCanonicalBitsLazy(stabilizer);
+    }
+    #if HAVE_PEXT
+        if constexpr (sizeof(Board) == sizeof(uint64_t)) {
+            auto [best, t] = msCpu::Dispatch<chooseCanonicalBits<Shape>>::
+                                                    call(board, stabilizer);
+            return { msBasicBoard(best), Transform(t) };
+        }
+    #endif
+    auto [best, t] = canonicalBits<Shape, false>(board, stabilizer);
+    return { msBasicBoard(best), Transform(t) };
+}
 
-    // Yes, calling transformBoard is more modular, but performance is essential
-    for (int i = 0; i < NUM_ROWS; i++) {
-        Row row = getRow(board, i);
-        Column col = getCol(board, i);
+/************ getCanonicalBitsLazy *********
+ Gets the same canonical board as getCanonicalBits, building the candidate
+ images a row at a time from the top and dropping each one as soon as a row
+ shows it is larger than another (see canonicalBitsLazy)
 
-        boards[DEGREE_90]  |= Board(REVERSED[col]) << rowShift[i];
-        boards[DEGREE_180] |= Board(REVERSED[row]) << rowShift[MAX_ROW - i];
-        boards[DEGREE_270] |= Board(col)           << rowShift[MAX_ROW - i];
-        boards[FLIP_H]     |= Board(REVERSED[row]) << rowShift[i];
-        boards[FLIP_V]     |= Board(row)           << rowShift[MAX_ROW - i];
-        boards[FLIP_DIAG]  |= Board(col)           << rowShift[i];
-        boards[FLIP_ANTI]  |= Board(REVERSED[col]) << rowShift[MAX_ROW - i];
-    }
+Parameters: 
+    uint8_t *stabilizer - as in getCanonicalBits
+    int *rowsCompared   - if not nullptr, set to the number of rows built 
+                          before a single image was left
+Returns: 
+    Exactly what getCanonicalBits returns
+Expects: 
+    b follows all Board invariants
+****************************************/
+template <typename Shape>
+std::pair<msBasicBoard<Shape>, typename msBasicBoard<Shape>::Transform> 
+        msBasicBoard<Shape>::getCanonicalBitsLazy(uint8_t *stabilizer,
+                                                  int *rowsCompared) const {
+    #if HAVE_PEXT
+        if constexpr (sizeof(Board) == sizeof(uint64_t)) {
+            auto [best, t] = msCpu::Dispatch<chooseCanonicalBitsLazy<Shape>>::
+                                        call(board, stabilizer, rowsCompared);
+            return { msBasicBoard(best), Transform(t) };
+        }
+    #endif
+    auto [best, t] = canonicalBitsLazy<Shape, false>(board, stabilizer, 
+                                                     rowsCompared);
+    return { msBasicBoard(best), Transform(t) };
+}
 
-    for (int i = 0; i < NUM_ROTATIONS; i++) {
-        if (boards[i] < best) {
-            best = boards[i];
-            bestTransform = Transform(i);
+/************ canonicalKeys *********
+ Canonicalizes a whole array of boards - the batch version of calling 
+ getCanonicalBits and then boardToBits on each of them
+
+Parameters: 
+    const msBoard *boards - the boards
+    size_t count          - how many there are
+    uint64_t *keys        - keys[i] is set to the boardToBits of boards[i]'s
+                            canonical board
+    Transform *transforms - transforms[i] is set to the Transform that turns
+                            boards[i] into its canonical board
+Returns: void
+Expects: 
+    keys and transforms have room for count entries
+Notes:
+    Boards of up to 8x8 are done several at a time, in the widest vectors
+    the cpu has (AVX-512, AVX2, else SSE2 / NEON) - see canonicalKeysLanes. 
+    Wider boards are done one at a time
+****************************************/
+template <typename Shape>
+void msBasicBoard<Shape>::canonicalKeys(const msBasicBoard *boards, 
+                                        size_t count, uint64_t *keys, 
+                                        Transform *transforms) {
+    if constexpr (ENABLE_PADDED_SYMMETRIES && PADDED_OK<Shape>) {
+        /*
+          The boards are copied out in chunks, so the kernels can load them
+          straight into vectors
+        */
+        constexpr size_t CHUNK = 256;
+        uint64_t chunk[CHUNK];
+        for (size_t i = 0; i < count; i += CHUNK) {
+            const size_t n = std::min(CHUNK, count - i);
+            for (size_t j = 0; j < n; j++) chunk[j] = boards[i + j].board;
+           #if HAVE_SIMD_DISPATCH
+            msCpu::Dispatch<chooseCanonicalKeys<Shape>>::call(chunk, n, 
+                                                keys + i, transforms + i);
+           #else
+            canonicalKeysLanes<Shape, 2>(chunk, n, keys + i, transforms + i);
+           #endif
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            auto [canonical, t] = boards[i].getCanonicalBits();
+            keys[i] = canonical.boardToBits();
+            transforms[i] = t;
         }
     }
-
-    return { msBoard(best), bestTransform };
 }
 
 
@@ -686,52 +2090,13 @@ Parameters: none
 Returns: 
     a std::string containing the details of the Move
 ****************************************/
-std::string msBoard::Move::toString() const
+template <typename Shape>
+std::string msBasicBoard<Shape>::Move::toString() const
 {
-        // Extract destination row/col
-        int destRow = -1, destCol = -1;
-        for (int r = 0; r < NUM_ROWS; r++) {
-            for (int c = COL_START_IDX[r]; c <= COL_END_IDX[r]; c++) {
-                if ((setBit >> bitIndex(r, c)) & 1ULL) {
-                    destRow = r;
-                    destCol = c;
-                }
-            }
-        }
-
-        // Extract origin and jumped bits
-        int originRow = -1, originCol = -1;
-        int jumpedRow = -1, jumpedCol = -1;
-
-        for (int r = 0; r < NUM_ROWS; r++) {
-            for (int c = COL_START_IDX[r]; c <= COL_END_IDX[r]; c++) {
-                if ((clearBits >> bitIndex(r, c)) & 1ULL) {
-                    // Decide which is origin vs jumped
-                    if ((std::abs(r - destRow) == 2 && c == destCol) ||
-                        (std::abs(c - destCol) == 2 && r == destRow)) {
-                        originRow = r;
-                        originCol = c;
-                    } else {
-                        jumpedRow = r;
-                        jumpedCol = c;
-                    }
-                }
-            }
-        }
-        (void) jumpedCol;
-        (void) jumpedRow;
-
-        // Determine direction
-        std::string dir;
-        if (originRow == destRow && originCol + 2 == destCol) dir = "right";
-        else if (originRow == destRow && originCol - 2 == destCol) dir = "left";
-        else if (originCol == destCol && originRow + 2 == destRow) dir = "down";
-        else if (originCol == destCol && originRow - 2 == destRow) dir = "up";
-        else dir = "unknown";
-
-    return  std::to_string(originRow) + " " + std::to_string(originCol) +  " "
-             + dir;
+    const MoveCoords &coords = MOVE_TABLE<Shape>.coords[index];
 
+    return std::to_string(coords.srcRow) + " " + 
+           std::to_string(coords.srcCol) + " " + DIRECTION_NAMES[coords.dir];
 }
 
 
@@ -749,13 +2114,16 @@ Returns:
 Notes:
     Parameters can be unplayable indices - function will just return false
 ****************************************/
-bool msBoard::isValidMove(int row, int col, int toRow, int toCol) const
+template <typename Shape>
+bool msBasicBoard<Shape>::isValidMove(int row, int col, int toRow, 
+                                      int toCol) const
 {
+    constexpr auto &PLAYABLE = Shape::PLAYABLE;
     int rowDif = std::abs(row - toRow);
     int colDif = std::abs(col - toCol);
 
 
-    if (toRow > MAX_ROW || toRow < 0 || toCol > MAX_COL || toCol < 0) {
+    if (toRow > MAX_ROW<Shape> || toRow < 0 || toCol > MAX_COL<Shape> || toCol < 0) {
         return false;
     }
     // source or destination is unplayable --> false
@@ -767,7 +2135,7 @@ bool msBoard::isValidMove(int row, int col, int toRow, int toCol) const
         return false;
     }
     // source must be a marble and destination must be empty
-    if (!getBit(board, row, col) || getBit(board, toRow, toCol)) {
+    if (!getBit<Shape>(board, row, col) || getBit<Shape>(board, toRow, toCol)) {
         return false;
     }
 
@@ -775,7 +2143,7 @@ bool msBoard::isValidMove(int row, int col, int toRow, int toCol) const
     int midRow = (row + toRow) / 2;
     int midCol = (col + toCol) / 2;
 
-    return getBit(board, midRow, midCol);
+    return getBit<Shape>(board, midRow, midCol);
 }
 /************ getAMove *********
  Gets a Move struct corresponding to the given input
@@ -786,27 +2154,23 @@ Parameters:
     int toRow - the destination row of the move
     int toCol - the destination column of the move
 Returns: 
-    a Move struct containing the set and clear bits to execute the move
+    the Move from (row, col) to (toRow, toCol)
 Expects:
     Should only be called with parameters that correspond to a valid move
 Notes:
     Will throw an error if the parameters are not valid
 ****************************************/
-msBoard::Move msBoard::getAMove(int row, int col, int toRow, int toCol) const
+template <typename Shape>
+typename msBasicBoard<Shape>::Move 
+        msBasicBoard<Shape>::getAMove(int row, int col, int toRow, 
+                                      int toCol) const
 {
     if (!isValidMove(row, col, toRow, toCol)) {
         throw std::runtime_error("Cannot get an invalid move\n");
     }
 
-    int midRow = (row + toRow) / 2;
-    int midCol = (col + toCol) / 2;
-
-    Board set =   1ULL << bitIndex(toRow, toCol);
-    Board clear = 1ULL << bitIndex(row, col);
-    
-    clear |=      1ULL << bitIndex(midRow, midCol);
-
-    return msBoard::Move(set, clear);
+    Direction d = directionOf(toRow - row, toCol - col);
+    return Move(MOVE_TABLE<Shape>.ids[row][col][d]);
 }
 
 /************ undoTransform *********
@@ -817,19 +2181,93 @@ Parameters:
     Move &m       - a reference to the Move to modify
     Transform t   - the transform we undo
 Returns: void
+Expects:
+    t is a symmetry of the Shape (like every Transform getCanonicalBits 
+    returns, and every composition of them)
+Notes:
+    May modify parameter m. This is a single move table lookup, so a whole
+    chain of transforms should be composed (see composeTransforms) and 
+    undone at once
+    Will CRE if t is not a symmetry of the Shape
+****************************************/
+template <typename Shape>
+void msBasicBoard<Shape>::undoTransform(Move &m, Transform t) const 
+{
+    uint8_t index = MOVE_TABLE<Shape>.images[D4_INVERSE[t]][m.index];
+    assert(index != NO_MOVE);
+    m = Move(index);
+}
+
+/************ interferingMoves *********
+ Returns every move that does not commute with a given move
+
+Parameters: 
+    Move m - the move to check against
+Returns: 
+    A MoveSet of every move that touches one of m's three positions, 
+    including m itself
 Notes:
-    May modify parameter m
+    Two moves that are both legal on a board and do not interfere can be 
+    played in either order - both orders reach the same board
 ****************************************/
-void msBoard::undoTransform(Move &m, Transform t) const 
+template <typename Shape>
+typename msBasicBoard<Shape>::MoveSet 
+        msBasicBoard<Shape>::interferingMoves(Move m)
 {
-    if (t == DEGREE_0) return;
+    MoveSet set;
+    for (int w = 0; w < MoveSet::WORDS; w++) {
+        set.words[w] = MOVE_TABLE<Shape>.interference[m.index][w];
+    }
+    return set;
+}
 
-    Transform inv = inverseTransform(t);
+/************ transformMoves *********
+ Maps every move of a MoveSet through a Transform
+
+Parameters: 
+    const MoveSet &moves - the moves to map
+    Transform t          - the transform to apply to them
+Returns: 
+    A MoveSet holding the image of every move in moves on the transformed 
+    board
+Expects:
+    t is a symmetry of the Shape
+Notes:
+    Will CRE if t is not a symmetry of the Shape
+****************************************/
+template <typename Shape>
+typename msBasicBoard<Shape>::MoveSet 
+        msBasicBoard<Shape>::transformMoves(const MoveSet &moves, Transform t)
+{
+    if (t == DEGREE_0) return moves;
+
+    MoveSet out;
+    for (int w = 0; w < MoveSet::WORDS; w++) {
+        for (uint64_t bits = moves.words[w]; bits; bits &= bits - 1) {
+            uint8_t index = MOVE_TABLE<Shape>.images[t]
+                                        [w * 64 + __builtin_ctzll(bits)];
+            assert(index != NO_MOVE);
+            out.insert(Move(index));
+        }
+    }
+    return out;
+}
 
-    Board newSet   = transformBoard(m.setBit,    inv);
-    Board newClear = transformBoard(m.clearBits, inv);
+/************ composeTransforms *********
+ Combines two transforms into the one Transform that has the same effect
 
-    m = Move(newSet, newClear);
+Parameters: 
+    Transform first  - the transform applied first
+    Transform second - the transform applied after first
+Returns: 
+    A Transform - applying it is the same as applying first, then second
+****************************************/
+template <typename Shape>
+typename msBasicBoard<Shape>::Transform 
+        msBasicBoard<Shape>::composeTransforms(Transform first, 
+                                               Transform second)
+{
+    return Transform(D4_COMPOSE[first][second]);
 }
 
 
@@ -843,14 +2281,16 @@ Parameters:
 Returns: 
     A new msBoard object with the given move undone
 Expects:
-    m should be a valid move to undo 
+    m should be a valid move to undo (see validUndoMoves)
 Notes:
     Does not error check
 ****************************************/
-msBoard msBoard::undoMove(const Move m) const 
+template <typename Shape>
+msBasicBoard<Shape> msBasicBoard<Shape>::undoMove(const Move m) const 
 {
-    Board next = (board & ~m.setBit) | m.clearBits;
-    return msBoard(next);
+    const MoveMasks<Shape> &mask = MOVE_TABLE<Shape>.masks[m.index];
+    Board next = (board & ~mask.setBit) | mask.clearBits;
+    return msBasicBoard(next);
 }
 
 /************ numRows *********
@@ -860,8 +2300,9 @@ Parameters: none
 Returns: 
     a int containing the number of rows on the board
 ****************************************/
-int msBoard::numRows() const {
-    return NUM_ROWS;
+template <typename Shape>
+int msBasicBoard<Shape>::numRows() const {
+    return NUM_ROWS<Shape>;
 }
 
 /************ numCols *********
@@ -871,6 +2312,13 @@ Parameters: none
 Returns: 
     a int containing the number of columns on the board
 ****************************************/
-int msBoard::numCols() const {
-    return NUM_COLS;
-}
\ No newline at end of file
+template <typename Shape>
+int msBasicBoard<Shape>::numCols() const {
+    return NUM_COLS<Shape>;
+}
+
+
+/************************ Explicit instantiations *****************************/
+template class msBasicBoard<FrenchShape>;
+template class msBasicBoard<EnglishShape>;
+template class msBasicBoard<WieglebShape>;
\ No newline at end of file
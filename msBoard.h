@@ -1,12 +1,12 @@
-
 /*
 *     msBoard.h
 *     By: Brendan Roy
 *     Date: December 30th, 2025
 *     Marble Solitaire
 *
-*     This file declares the msBoard.h interface. An msBoard is a French
-*     Marble Solitaire board, with the following default layout:
+*     This file declares the msBoard.h interface. An msBasicBoard is a Marble
+*     Solitaire board of any shape described by msShape.h.
+*     msBoard is the French board, with the following default layout:
 *            . ● ●
 *          ● ● ● ● ●
 *        ● ● ● ● ● ● ●
@@ -14,83 +14,165 @@
 *        ● ● ● ● ● ● ●
 *          ● ● ● ● ●
 *            ● ● ●
+*     msEnglishBoard is the 33 hole English board, and msWieglebBoard is the
+*     45 hole board on a 9x9 grid, which is held in 128 bits.
 *                
 */
 
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <string>
 
+#include "msShape.h"
+
 #ifndef MSBOARD_H_
 #define MSBOARD_H_
 
-class msBoard {
+template <typename Shape>
+class msBasicBoard {
 
-    using Board = uint64_t;
+    using Board = typename ShapeTraits<Shape>::Word;
 
     public:
         struct Move;
+        class MoveList;
+        class MoveSet;
         /*
         Most boards have 8 equivalent states - one for each rotation / mirroring
         */
-        enum Transform { DEGREE_0 = 0, DEGREE_90, DEGREE_180, DEGREE_270,
+        enum Transform : uint8_t { DEGREE_0 = 0, DEGREE_90, DEGREE_180, DEGREE_270,
                         FLIP_H, FLIP_V, FLIP_DIAG, FLIP_ANTI
         };
     
-        msBoard();
-        msBoard(unsigned row, unsigned col);
+        static constexpr int NUM_CELLS = ShapeTraits<Shape>::NUM_CELLS;
+        static constexpr int NUM_MOVES = ShapeTraits<Shape>::NUM_MOVES;
+        static_assert(NUM_MOVES < 256, "Moves are one byte move table indices");
 
-        ~msBoard() = default;
+        msBasicBoard();
+        msBasicBoard(unsigned row, unsigned col);
+
+        ~msBasicBoard() = default;
 
 
         bool hasWon() const;
-        void validMoves(std::vector<Move> &moves) const;
-        msBoard applyMove(const Move m) const;
+        int numMarbles() const;
+        int numDeadMarbles() const;
+        bool isSplitByMersonRegion() const;
+        void validMoves(MoveList &moves) const;
+        void validMoves(MoveList &moves, uint8_t stabilizer) const;
+        void validUndoMoves(MoveList &moves) const;
+        msBasicBoard applyMove(const Move m) const;
         void printBoard(std::ostream &stream) const;
-        std::pair<msBoard, msBoard::Transform> getCanonicalBits() const;
-        msBoard getCanonicalBoard() const;
+        std::pair<msBasicBoard, Transform> getCanonicalBits(
+                                        uint8_t *stabilizer = nullptr) const;
+        std::pair<msBasicBoard, Transform> getCanonicalBitsLazy(
+                                        uint8_t *stabilizer = nullptr,
+                                        int *rowsCompared = nullptr) const;
+        static void canonicalKeys(const msBasicBoard *boards, size_t count,
+                                  uint64_t *keys, Transform *transforms);
+        msBasicBoard getCanonicalBoard() const;
         Move getAMove(int row, int col, int toRow, int toCol) const;
         bool isValidMove(int row, int col, int toRow, int toCol) const;
 
         void undoTransform(Move &m, Transform rot) const;
+        static Transform composeTransforms(Transform first, Transform second);
+
+        static MoveSet interferingMoves(Move m);
+        static MoveSet transformMoves(const MoveSet &moves, Transform t);
 
 
         uint64_t boardToBits() const; 
 
-        msBoard undoMove(const Move m) const;
+        msBasicBoard undoMove(const Move m) const;
 
         int numRows() const;
         int numCols() const;
 
-        /* Other classes may use Moves but not modify or create them */
+        /* 
+          Other classes may use Moves but not modify or create them. A Move 
+          is a one byte index into the Shape's move table (see msBoard.cpp),
+          which holds its bit masks and coordinates
+        */
         struct Move {
           public:
 
             std::string toString() const;
             Move(const Move&) = default;
-            Move &operator=(const Move &other) {
-                if (this == &other) return *this;
-                this->setBit = other.setBit;
-                this->clearBits = other.clearBits;
-                return *this;
-            }
-            
+            Move &operator=(const Move &other) = default;
 
           private:
             
-            Board setBit;
-            Board clearBits;
-            Move(Board s, Board c) : setBit(s), clearBits(c) {}
+            uint8_t index;
+            Move() = default;
+            constexpr explicit Move(uint8_t i) : index(i) {}
 
-            friend class msBoard;
+            friend class msBasicBoard;
+            friend class MoveList;
+            friend class MoveSet;
+        };
+
+        /* 
+          A fixed-capacity list of Moves that lives wherever it is declared
+          (usually the stack) - a board can never have more than NUM_MOVES 
+          legal moves, so validMoves never allocates
+        */
+        class MoveList {
+          public:
+            size_t size() const { return count; }
+            bool empty() const { return count == 0; }
+            void clear() { count = 0; }
+            Move operator[](size_t i) const { return items[i]; }
+            const Move *begin() const { return items; }
+            const Move *end() const { return items + count; }
+
+          private:
+            Move items[NUM_MOVES];
+            size_t count = 0;
+
+            friend class msBasicBoard;
+        };
+
+        /* 
+          A set of Moves with one bit per move table entry. Plain data, so it
+          can live inside the solver's stack frames
+        */
+        class MoveSet {
+          public:
+            static constexpr int WORDS = (NUM_MOVES + 63) / 64;
+
+            void insert(Move m) { 
+                words[m.index >> 6] |= uint64_t(1) << (m.index & 63); 
+            }
+            bool contains(Move m) const { 
+                return (words[m.index >> 6] >> (m.index & 63)) & 1; 
+            }
+            bool empty() const {
+                uint64_t any = 0;
+                for (uint64_t w : words) any |= w;
+                return any == 0;
+            }
+            void clear() { 
+                for (uint64_t &w : words) w = 0; 
+            }
+            // removes every Move that is also in other
+            void removeAll(const MoveSet &other) {
+                for (int i = 0; i < WORDS; i++) words[i] &= ~other.words[i];
+            }
+
+          private:
+            uint64_t words[WORDS] = {};
+
+            friend class msBasicBoard;
         };
 
     private:
-        msBoard(Board b);
+        msBasicBoard(Board b);
         Board board;
-
-        static std::vector<Move> setupAllMoves();
-        static const std::vector<Move> ALL_MOVES;
 };
 
+using msBoard        = msBasicBoard<FrenchShape>;
+using msEnglishBoard = msBasicBoard<EnglishShape>;
+using msWieglebBoard = msBasicBoard<WieglebShape>;
+
 #endif
@@ -0,0 +1,169 @@
+/*
+    msCpu.h
+    Marble Solitaire
+
+    Which optional instructions the cpu running us has, found once, the
+    first time a kernel asks. The hot board kernels in msBoard.cpp are 
+    compiled both for any x86-64 cpu and for cpus with BMI2 (the pext 
+    instruction), and pick one of them at run time from what is found here -
+    so a portable build still uses pext where it exists, and a build never
+    uses it where it doesn't.
+
+    Having pext is not enough: AMD cpus before Zen 3 run it as microcode,
+    taking tens to hundreds of cycles where Intel's take 3, which makes it
+    far slower than the shifts it replaces. So pext is only used if a short
+    timing loop finds it fast (see PEXT_MAX_RATIO). The batch 
+    canonicalization kernel is picked the same way, from AVX2 / AVX-512.
+*/
+
+#ifndef MSCPU_H_
+#define MSCPU_H_
+
+#include "configuration.h"
+#include "msCycles.h"
+
+#include <atomic>
+#include <cstdint>
+
+#if HAVE_PEXT
+    #include <immintrin.h>
+#endif
+
+namespace msCpu {
+
+    /*
+      pext counts as fast if a dependent chain of pext instructions takes at
+      most PEXT_MAX_RATIO times as long as the same chain of multiplies. Both
+      take 3 cycles on cpus with a real pext, while microcoded ones take 18+
+      even for the sparsest masks. Comparing with multiplies keeps the check
+      independent of the clock speed and of how cycle counter ticks relate
+      to it
+    */
+    constexpr uint64_t PEXT_MAX_RATIO = 2;
+    constexpr int PEXT_TIMING_STEPS = 1024;
+
+    /************ Features *********
+     What the cpu supports
+
+    Members:
+        bool bmi2     - the cpu has BMI2 (pext / pdep)
+        bool avx2     - the cpu has AVX2
+        bool avx512   - the cpu has AVX-512 (the F subset)
+        bool fastPext - bmi2, and pext passed the timing check
+    *********************************/
+    struct Features {
+        bool bmi2 = false;
+        bool avx2 = false;
+        bool avx512 = false;
+        bool fastPext = false;
+    };
+
+#if HAVE_PEXT
+    /************ chainTicks *********
+     Times a chain of PEXT_TIMING_STEPS dependent pext instructions, or of
+     the same number of multiplies
+
+    Parameters:
+        bool pext - time pext if true, multiplies if false
+    Returns:
+        A uint64_t - the cycle counter ticks the fastest of a few runs took
+    Notes:
+        Must only be called with pext true on cpus with BMI2. The pext mask 
+        picks one bit out of every byte, like the column masks of a 7x7 
+        board. The best of several runs is kept so an interrupt can't skew
+        the check
+    *********************************/
+    __attribute__((target("bmi2"), noinline))
+    inline uint64_t chainTicks(bool pext)
+    {
+        uint64_t best = UINT64_MAX;
+        for (int run = 0; run < 4; run++) {
+            volatile uint64_t seed = 0x0123456789ABCDEFULL;
+            uint64_t v = seed;
+            uint64_t start = readCycles();
+            if (pext) {
+                for (int i = 0; i < PEXT_TIMING_STEPS; i++) {
+                    v = _pext_u64(v, 0x0102040810204080ULL) ^ (v << 9) ^ i;
+                }
+            } else {
+                for (int i = 0; i < PEXT_TIMING_STEPS; i++) {
+                    v = (v * 0x9E3779B97F4A7C15ULL) ^ (v << 9) ^ i;
+                }
+            }
+            uint64_t ticks = readCycles() - start;
+            seed = v;
+            if (ticks < best) best = ticks;
+        }
+        return best;
+    }
+#endif
+
+    /************ detect *********
+     Reads cpuid and times pext
+
+    Parameters: none
+    Returns:
+        The Features of this cpu - all false when not on x86-64
+    *********************************/
+    inline Features detect()
+    {
+        Features f;
+    #if HAVE_PEXT || HAVE_SIMD_DISPATCH
+        __builtin_cpu_init();
+        f.bmi2 = __builtin_cpu_supports("bmi2");
+        f.avx2 = __builtin_cpu_supports("avx2");
+        f.avx512 = __builtin_cpu_supports("avx512f");
+    #endif
+    #if HAVE_PEXT
+        f.fastPext = f.bmi2 && 
+                     chainTicks(true) <= PEXT_MAX_RATIO * chainTicks(false);
+    #endif
+        return f;
+    }
+
+    /************ features *********
+     Returns this cpu's Features - detected on the first call only
+    *********************************/
+    inline const Features &features()
+    {
+        static const Features FEATURES = detect();
+        return FEATURES;
+    }
+
+    /************ Dispatch *********
+     A kernel with one version per kind of cpu. Pick is a function that 
+     looks at features() and returns a pointer to the version to use - 
+     Dispatch<Pick>::call runs that version with the arguments it is given
+
+    Notes:
+        The pointer starts out at resolve, which runs Pick, stores what it
+        returns and forwards to it - so Pick only runs on the first call, 
+        and every later one is a load and an indirect call, with no check
+        of whether the cpu was detected yet. The pointer is constant 
+        initialized, so calls from other files' static initializers are 
+        safe, and threads racing to resolve it all store the same value
+    *********************************/
+    template <auto Pick, typename Fn = decltype(Pick())>
+    class Dispatch;
+
+    template <auto Pick, typename R, typename... Args>
+    class Dispatch<Pick, R (*)(Args...)> {
+      public:
+        static R call(Args... args)
+        {
+            return chosen.load(std::memory_order_relaxed)(args...);
+        }
+
+      private:
+        static R resolve(Args... args)
+        {
+            R (*fn)(Args...) = Pick();
+            chosen.store(fn, std::memory_order_relaxed);
+            return fn(args...);
+        }
+
+        static inline std::atomic<R (*)(Args...)> chosen{resolve};
+    };
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+    msCycles.h
+    Marble Solitaire
+
+    A tiny wrapper around the cpu's cycle counter so the benchmarks and the
+    profiling counters can time very short sections of code. On x86 this is
+    rdtsc - everywhere else it falls back to a nanosecond clock, so "cycles"
+    should be read as "ticks" on those hosts.
+*/
+
+#ifndef MSCYCLES_H_
+#define MSCYCLES_H_
+
+#include "configuration.h"
+
+#include <cstdint>
+
+#if HAVE_RDTSC
+    #include <x86intrin.h>
+#else
+    #include <chrono>
+#endif
+
+/************ readCycles *********
+ Returns the current value of the cycle counter
+
+Parameters: none
+Returns: 
+    A uint64_t - the number of ticks since some arbitrary point in the past.
+                 Only differences between two calls are meaningful
+Notes:
+    Not serializing - the cpu may reorder it slightly with nearby instructions,
+    which is fine when timing loops of many operations
+*********************************/
+inline uint64_t readCycles()
+{
+    #if HAVE_RDTSC
+        return __rdtsc();
+    #else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    #endif
+}
+
+#endif
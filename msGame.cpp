@@ -147,7 +147,7 @@ bool msGame::makeMove(unsigned row, unsigned col, Direction dir)
  ********************************************/
 bool msGame::hasMoves() const
 {
-    std::vector<msBoard::Move> m;
+    msBoard::MoveList m;
     board.validMoves(m);
 
     return !m.empty();
@@ -226,6 +226,27 @@ void msGame::useCustomBoard(unsigned row, unsigned col)
 
 
 
+/**************** getSolverStats ***************
+ Solves the current board and prints the solver's statistics for that solve
+
+ Parameters: 
+    std::ostream &stream - a reference to the output stream we print to
+ Returns: void
+ Expects: nothing
+ Notes: May take several seconds to run - must solve whole board. Most of the
+        statistics are only collected when COLLECT_SOLVER_STATS is set
+ ********************************************/
+void msGame::getSolverStats(std::ostream &stream) const
+{
+    msSolver::SolverStats stats;
+    std::vector<msBoard::Move> solution = msSolver::solve(board, &stats);
+
+    stream << (solution.empty() ? "No solution exists." : "Solvable.") 
+           << std::endl;
+    stats.print(stream);
+}
+
+
 // For testing purposes only 
 void msGame::timeGame() 
 {
@@ -1,4 +1,3 @@
-
 /*
 *     msGame.h
 *     By: Brendan Roy
@@ -43,6 +42,7 @@ class msGame {
         bool hasMoves() const;
         bool hasWon() const;
         void useCustomBoard(unsigned row, unsigned col);
+        void getSolverStats(std::ostream &stream) const;
 
         // for testing:
         void timeGame();
@@ -0,0 +1,106 @@
+/*
+    msMemory.h
+    Marble Solitaire
+
+    Finds out how much memory this process can use, so the solver can pick
+    a visited-set backend that fits (see chooseBackend in msSolver.cpp).
+    That is the smallest of the memory the kernel reports as available and
+    whatever is left under the process's cgroup limit, if it has one
+    (cgroup v2 and v1 are both checked) - a container's limit is usually far
+    below the host's free memory.
+*/
+
+#ifndef MSMEMORY_H_
+#define MSMEMORY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <sys/sysinfo.h>
+
+namespace msMemory {
+
+    /************ readNumber *********
+     Reads the first number in a file
+
+    Parameters:
+        const char *path - the file to read
+        uint64_t &value  - set to the number, if there is one
+    Returns:
+        A bool - false if the file can't be read or doesn't start with a
+                 number (cgroup files hold "max" when there is no limit)
+    *********************************/
+    inline bool readNumber(const char *path, uint64_t &value)
+    {
+        FILE *file = std::fopen(path, "r");
+        if (!file) return false;
+        unsigned long long number = 0;
+        bool found = std::fscanf(file, "%llu", &number) == 1;
+        std::fclose(file);
+        if (found) value = number;
+        return found;
+    }
+
+    /************ meminfoAvailable *********
+     Reads MemAvailable (free memory plus page cache the kernel can drop)
+     from /proc/meminfo
+
+    Parameters:
+        uint64_t &bytes - set to MemAvailable in bytes, if it is there
+    Returns:
+        A bool - false on kernels older than 3.14, which don't report it
+    *********************************/
+    inline bool meminfoAvailable(uint64_t &bytes)
+    {
+        FILE *file = std::fopen("/proc/meminfo", "r");
+        if (!file) return false;
+        char line[128];
+        bool found = false;
+        while (!found && std::fgets(line, sizeof line, file)) {
+            unsigned long long kib = 0;
+            if (std::sscanf(line, "MemAvailable: %llu kB", &kib) == 1) {
+                bytes = uint64_t(kib) * 1024;
+                found = true;
+            }
+        }
+        std::fclose(file);
+        return found;
+    }
+
+    /************ usableBytes *********
+     Returns how many bytes of memory this process can still allocate
+     without swapping or being killed
+
+    Parameters: none
+    Returns:
+        A uint64_t - the smallest of MemAvailable (or sysinfo's free plus
+                     buffer memory when that is missing) and the room left
+                     under the cgroup v2 / v1 memory limit
+    *********************************/
+    inline uint64_t usableBytes()
+    {
+        uint64_t bytes = UINT64_MAX;
+        if (!meminfoAvailable(bytes)) {
+            struct sysinfo info;
+            if (sysinfo(&info) == 0) {
+                bytes = (uint64_t(info.freeram) + info.bufferram) *
+                        info.mem_unit;
+            }
+        }
+
+        static const char *const LIMITS[][2] = {
+            { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current" },
+            { "/sys/fs/cgroup/memory/memory.limit_in_bytes",
+              "/sys/fs/cgroup/memory/memory.usage_in_bytes" }
+        };
+        for (const auto &files : LIMITS) {
+            uint64_t limit = 0, used = 0;
+            if (!readNumber(files[0], limit)) continue;
+            readNumber(files[1], used);
+            bytes = std::min(bytes, limit > used ? limit - used : 0);
+        }
+        return bytes;
+    }
+}
+
+#endif
@@ -0,0 +1,468 @@
+/*
+    msQuotientSet.h
+    Marble Solitaire
+
+    A compact hash set of fixed-width keys (the packed boards from
+    boardToBits - 37 bits for French boards). Each key is first scrambled by
+    an invertible mix, then split into a quotient (its top bits), which picks
+    its home slot and is never stored, and a remainder (the rest), which is.
+    A slot holds the remainder and how far the key had to be moved from its
+    home slot, so the quotient can be recovered from the slot's position.
+    Collisions are resolved with Robin Hood linear probing.
+
+    Slots are a uint32_t, until the set has so many that the remainder and
+    displacement fit in a uint16_t - 2^(bits - 8) slots, so 2^29 for French
+    boards. Between the 45% load right after growing and the 90% maximum,
+    that is 4.4 - 8.9 bytes per key for small sets and 2.2 - 4.4 for the
+    big ones that memory is a problem for, against the 11 - 22 of a
+    robin_hood::unordered_flat_set<uint64_t>.
+*/
+
+#ifndef MSQUOTIENTSET_H_
+#define MSQUOTIENTSET_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class msQuotientSet {
+
+public:
+
+    // the widest keys the set takes - they start with 2^24 slots (64MiB)
+    static constexpr int MAX_KEY_BITS = 48;
+
+    /************ msQuotientSet constructor *********
+     Creates an empty set
+
+    Parameters:
+        int bits        - every key is less than 2^bits
+        int initialLog2 - the set starts with 2^initialLog2 slots
+    Expects:
+        bits is at most MAX_KEY_BITS
+    Notes:
+        The number of slots is raised if the remainders of the keys would 
+        not fit next to the displacement in a slot - keys of more than 24 
+        bits need at least 2^(bits - 24) slots
+        Will CRE if bits is out of range
+    *********************************/
+    msQuotientSet(int bits, int initialLog2)
+        : keyBits(bits)
+    {
+        assert(keyBits > 0 && keyBits <= MAX_KEY_BITS);
+        int minLog2 = keyBits - REMAINDER_BITS_MAX;
+        int log2 = initialLog2 > minLog2 ? initialLog2 : minLog2;
+        if (log2 > keyBits) log2 = keyBits;
+        resize(log2 < 1 ? 1 : log2);
+    }
+
+    /************ testAndSet *********
+     Adds a key to the set
+
+    Parameters:
+        uint64_t key - the key to add
+    Returns:
+        A bool - true if and only if the key was already in the set
+    Expects:
+        key < 2^keyBits
+    *********************************/
+    bool testAndSet(uint64_t key)
+    {
+        assert(key <= keyMask);
+        const uint64_t h = mix(key);
+        return withSlots([&](auto *s) -> bool { return insert(s, h); });
+    }
+
+    /************ contains *********
+     Looks a key up without adding it
+
+    Parameters:
+        uint64_t key - the key to look for
+    Returns:
+        A bool - true if and only if the key is in the set
+    Expects:
+        key < 2^keyBits
+    *********************************/
+    bool contains(uint64_t key) const
+    {
+        assert(key <= keyMask);
+        const uint64_t h = mix(key);
+        return withSlots([&](const auto *s) {
+            uint64_t pos;
+            uint32_t d;
+            return probe(s, h, pos, d);
+        });
+    }
+
+    /************ prefetch *********
+     Starts loading the slot a key's probe sequence begins at into the cache,
+     so a testAndSet of the key soon after does not wait on memory
+
+    Parameters:
+        uint64_t key - the key that will be looked up
+    Notes:
+        Always inlined - GCC treats a call that only prefetches as having no
+        effect, and drops it if it is not inlined early
+    *********************************/
+    __attribute__((always_inline)) void prefetch(uint64_t key) const
+    {
+        const uint64_t pos = mix(key) >> remainderBits;
+        if (slots.isNarrow) __builtin_prefetch(&slots.narrow[pos], 1);
+        else __builtin_prefetch(&slots.wide[pos], 1);
+    }
+
+    /************ clear *********
+     Removes every key but keeps the slots allocated
+    *********************************/
+    void clear()
+    {
+        slots.clear();
+        numKeys = 0;
+    }
+
+    /************ size / numSlots / loadFactor / bytesUsed *********
+     The number of keys, the number of slots, the fraction of slots in use
+     and the bytes of slot storage
+    *********************************/
+    uint64_t size() const { return numKeys; }
+    uint64_t numSlots() const { return slotMask + 1; }
+    double loadFactor() const { return double(numKeys) / numSlots(); }
+    uint64_t bytesUsed() const { return slots.bytes(); }
+
+private:
+    /*
+      A slot is (displacement + 1) << remainderBits | remainder, so 0 marks
+      an empty slot. DISPLACEMENT_BITS bounds how far a key can be from its
+      home - a key that would go further makes the set grow instead
+    */
+    static constexpr int SLOT_BITS = 32;
+    static constexpr int NARROW_SLOT_BITS = 16;
+    static constexpr int DISPLACEMENT_BITS = 8;
+    static constexpr int REMAINDER_BITS_MAX = SLOT_BITS - DISPLACEMENT_BITS;
+    static constexpr uint32_t MAX_DISPLACEMENT = (1u << DISPLACEMENT_BITS) - 2;
+    static constexpr uint32_t EMPTY = 0;
+
+    // maximum load, in percent, before the set doubles
+    static constexpr uint64_t MAX_LOAD_PERCENT = 90;
+
+    // odd multipliers - multiplying by an odd number is invertible mod 2^k
+    static constexpr uint64_t MIX_1 = 0x9E3779B97F4A7C15ULL;
+    static constexpr uint64_t MIX_2 = 0xC2B2AE3D27D4EB4FULL;
+
+    int keyBits;
+    int slotLog2 = 0;
+    int remainderBits = 0;
+    uint64_t keyMask = 0;
+    uint64_t slotMask = 0;
+    uint64_t maxKeys = 0;
+    uint64_t numKeys = 0;
+
+    /************ Slots *********
+     The slot array - uint16_t slots when the remainder and displacement
+     fit in one, uint32_t otherwise. Only one of the two vectors is ever
+     allocated, and which one only changes in resize. The hot paths pick
+     the vector once per call (see withSlots) - get and set check it on
+     every access, and are only used while growing
+    *********************************/
+    struct Slots {
+        std::vector<uint16_t> narrow;
+        std::vector<uint32_t> wide;
+        bool isNarrow = false;
+
+        uint32_t get(uint64_t pos) const
+        {
+            return isNarrow ? narrow[pos] : wide[pos];
+        }
+
+        void set(uint64_t pos, uint32_t slot)
+        {
+            if (isNarrow) narrow[pos] = uint16_t(slot);
+            else wide[pos] = slot;
+        }
+
+        void assign(size_t count, bool narrowSlots)
+        {
+            isNarrow = narrowSlots;
+            std::vector<uint16_t>().swap(narrow);
+            std::vector<uint32_t>().swap(wide);
+            if (isNarrow) narrow.assign(count, EMPTY);
+            else wide.assign(count, EMPTY);
+        }
+
+        void clear()
+        {
+            std::fill(narrow.begin(), narrow.end(), EMPTY);
+            std::fill(wide.begin(), wide.end(), EMPTY);
+        }
+
+        uint64_t bytes() const
+        {
+            return narrow.size() * sizeof(uint16_t) +
+                   wide.size() * sizeof(uint32_t);
+        }
+    };
+    Slots slots;
+
+    /************ withSlots *********
+     Calls fn with a pointer to the first slot, of whichever width the
+     slots are now, and returns what it returns (a bool)
+    *********************************/
+    template <typename Fn>
+    bool withSlots(Fn fn)
+    {
+        return slots.isNarrow ? fn(slots.narrow.data())
+                              : fn(slots.wide.data());
+    }
+
+    template <typename Fn>
+    bool withSlots(Fn fn) const
+    {
+        return slots.isNarrow ? fn(slots.narrow.data())
+                              : fn(slots.wide.data());
+    }
+
+    /************ insert *********
+     testAndSet of a scrambled key, on slots of type Slot
+
+    Parameters:
+        Slot *s    - the first slot
+        uint64_t h - the scrambled key
+    Returns:
+        A bool - true if and only if h was already in the set
+    *********************************/
+    template <typename Slot>
+    bool insert(Slot *s, uint64_t h)
+    {
+        uint64_t pos;
+        uint32_t d;
+        if (probe(s, h, pos, d)) return true;
+
+        if (numKeys + 1 > maxKeys || !place(s, h, pos, d)) {
+            growAndInsert(h);
+        } else {
+            numKeys++;
+        }
+        return false;
+    }
+
+    /************ growAndInsert *********
+     Grows the set until a scrambled key that is not in it yet fits, and
+     adds it
+
+    Notes:
+        Kept out of line so insert stays small enough to inline. Growing can
+        change the width of the slots, so the key goes through withSlots
+        again after every grow
+    *********************************/
+    __attribute__((noinline)) void growAndInsert(uint64_t h)
+    {
+        bool placed = false;
+        while (!placed) {
+            grow();
+            placed = withSlots([&](auto *s) -> bool {
+                uint64_t pos;
+                uint32_t d;
+                probe(s, h, pos, d);
+                return numKeys + 1 <= maxKeys && place(s, h, pos, d);
+            });
+        }
+        numKeys++;
+    }
+
+    /************ mix *********
+     Scrambles a key with a bijection on keyBits bit numbers, so that the
+     quotients of similar boards land far apart
+
+    Parameters:
+        uint64_t key - the key to scramble
+    Returns:
+        A uint64_t - the scrambled key, also less than 2^keyBits
+    *********************************/
+    uint64_t mix(uint64_t key) const
+    {
+        uint64_t h = (key * MIX_1) & keyMask;
+        h ^= h >> ((keyBits + 1) / 2);
+        return (h * MIX_2) & keyMask;
+    }
+
+    /************ probe *********
+     Looks for a scrambled key along its probe sequence
+
+    Parameters:
+        const Slot *s - the first slot
+        uint64_t h    - the scrambled key
+        uint64_t &pos - set to the slot h is in, or the slot it belongs in
+        uint32_t &d   - set to the displacement of that slot from h's home
+    Returns:
+        A bool - true iff h is in the set
+    Notes:
+        Robin Hood order lets the search stop at the first slot whose key is
+        closer to its own home than h would be - h would go right there
+    *********************************/
+    template <typename Slot>
+    bool probe(const Slot *s, uint64_t h, uint64_t &pos, uint32_t &d) const
+    {
+        const uint32_t remainder = uint32_t(h & remainderMask());
+        pos = h >> remainderBits;
+
+        for (d = 0; ; d++) {
+            const uint32_t slot = s[pos];
+            if (slot == EMPTY) return false;
+            const uint32_t slotDisplacement = displacement(slot);
+            if (slotDisplacement < d) return false;
+            if (slotDisplacement == d && 
+                    (slot & remainderMask()) == remainder) return true;
+            pos = (pos + 1) & slotMask;
+        }
+    }
+
+    /************ place *********
+     Stores a scrambled key that is not in the set yet
+
+    Parameters:
+        Slot *s      - the first slot
+        uint64_t h   - the scrambled key
+        uint64_t pos - the slot probe found for h
+        uint32_t d   - the displacement probe found for h
+    Returns:
+        A bool - false if h, or a key it pushes along, would end up more 
+                 than MAX_DISPLACEMENT from its home - the slots are then 
+                 left unchanged
+    Notes:
+        Every key from h's slot up to the next empty slot moves on by one
+    *********************************/
+    template <typename Slot>
+    bool place(Slot *s, uint64_t h, uint64_t pos, uint32_t d)
+    {
+        if (d > MAX_DISPLACEMENT) return false;
+
+        uint64_t end = pos;
+        for (; s[end] != EMPTY; end = (end + 1) & slotMask) {
+            if (displacement(s[end]) >= MAX_DISPLACEMENT) return false;
+        }
+        for (; end != pos; end = (end - 1) & slotMask) {
+            s[end] = Slot(s[(end - 1) & slotMask] +
+                          (uint32_t(1) << remainderBits));
+        }
+        s[pos] = Slot(((d + 1) << remainderBits) |
+                      uint32_t(h & remainderMask()));
+        return true;
+    }
+
+    uint64_t remainderMask() const 
+    { 
+        return (uint64_t(1) << remainderBits) - 1; 
+    }
+
+    uint32_t displacement(uint32_t slot) const 
+    { 
+        return (slot >> remainderBits) - 1; 
+    }
+
+    /************ resize *********
+     Replaces the slots with 2^log2 empty ones
+    *********************************/
+    void resize(int log2)
+    {
+        slotLog2 = log2;
+        remainderBits = keyBits - log2;
+        assert(remainderBits + DISPLACEMENT_BITS <= SLOT_BITS);
+        keyMask = (uint64_t(1) << keyBits) - 1;
+        slotMask = (uint64_t(1) << log2) - 1;
+        maxKeys = (uint64_t(1) << log2) * MAX_LOAD_PERCENT / 100;
+        slots.assign(size_t(1) << log2,
+                     remainderBits + DISPLACEMENT_BITS <= NARROW_SLOT_BITS);
+    }
+
+    /************ grow *********
+     Doubles the number of slots and places every key again
+
+    Notes:
+        Each key's scrambled value is rebuilt from its slot - the home slot
+        is the slot's position minus its displacement
+        Will CRE if the set would need more slots than there are keys
+    *********************************/
+    void grow()
+    {
+        assert(slotLog2 < keyBits);
+        Slots old = std::move(slots);
+        const int oldRemainderBits = remainderBits;
+        const uint64_t oldMask = slotMask;
+        const uint64_t oldRemainderMask = remainderMask();
+        resize(slotLog2 + 1);
+
+        /*
+          Walking the old slots from just after an empty one visits the keys
+          in order of their home slot, if homes before that empty slot count 
+          one lap later. Splitting each home's keys by the remainder bit that
+          becomes part of the quotient keeps that order in the new slots, so
+          every key just goes in the first free slot at or after its new home
+          and nothing placed before it ever moves. positions and cursor count
+          slots without wrapping
+        */
+        uint64_t start = 0;
+        while (old.get(start) != EMPTY) start++;
+
+        uint64_t cursor = 0;
+        uint64_t group[MAX_DISPLACEMENT + 2];
+        int groupSize = 0;
+        uint64_t groupHome = 0;
+        bool fits = true;
+
+        auto flush = [&]() {
+            for (int bit = 0; bit < 2; bit++) {
+                for (int k = 0; k < groupSize; k++) {
+                    const uint64_t h = group[k];
+                    if (int((h >> (remainderBits)) & 1) != bit) continue;
+                    const uint64_t lap = groupHome < start ? 1 : 0;
+                    const uint64_t home = (h >> remainderBits) + 
+                                          (lap << slotLog2);
+                    const uint64_t at = std::max(home, cursor);
+                    fits &= at - home <= MAX_DISPLACEMENT;
+                    slots.set(at & slotMask,
+                              (uint32_t(at - home + 1) << remainderBits) |
+                              uint32_t(h & remainderMask()));
+                    cursor = at + 1;
+                }
+            }
+            groupSize = 0;
+        };
+
+        for (uint64_t i = 1; i <= oldMask + 1; i++) {
+            const uint64_t pos = (start + i) & oldMask;
+            const uint32_t slot = old.get(pos);
+            if (slot == EMPTY) continue;
+            const uint64_t home = (pos - ((slot >> oldRemainderBits) - 1)) 
+                                  & oldMask;
+            if (groupSize && home != groupHome) flush();
+            groupHome = home;
+            group[groupSize++] = (home << oldRemainderBits) | 
+                                 (slot & oldRemainderMask);
+        }
+        flush();
+
+        // the doubled slots can only be more crowded with pathological keys
+        if (!fits) {
+            resize(slotLog2);
+            for (uint64_t pos = 0; pos <= oldMask; pos++) {
+                const uint32_t slot = old.get(pos);
+                if (slot == EMPTY) continue;
+                const uint64_t home = (pos - ((slot >> oldRemainderBits) - 1))
+                                      & oldMask;
+                const uint64_t h = (home << oldRemainderBits) | 
+                                   (slot & oldRemainderMask);
+                bool placed = withSlots([&](auto *s) {
+                    uint64_t at;
+                    uint32_t d;
+                    return !probe(s, h, at, d) && place(s, h, at, d);
+                });
+                assert(placed);
+                (void) placed;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+    msRecentFilter.h
+    Marble Solitaire
+
+    A small direct-mapped cache of recently seen keys, kept in front of a
+    visited set. Each key has exactly one slot, picked by a multiplicative
+    hash, and a new key simply overwrites whatever was there. A key found in
+    its slot is known to be in the visited set, so a hit never needs to
+    touch the (much larger, cache-missing) set behind it. Anything else just
+    falls through to the set.
+
+    Transpositions a few moves apart reach the same board within a short
+    stretch of the search, and those are the hits this catches.
+*/
+
+#ifndef MSRECENTFILTER_H_
+#define MSRECENTFILTER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+class msRecentFilter {
+
+public:
+
+    /************ msRecentFilter constructor *********
+     Creates an empty filter
+
+    Parameters:
+        int log2 - the filter has 2^log2 slots of 8 bytes (0 makes a filter
+                   that holds nothing)
+    *********************************/
+    explicit msRecentFilter(int log2)
+        : shift(64 - log2), slots(log2 > 0 ? size_t(1) << log2 : 0, EMPTY)
+    {
+    }
+
+    /************ testAndSet *********
+     Looks a key up and leaves it in its slot
+
+    Parameters:
+        uint64_t key - the key to look up
+    Returns:
+        A bool - true iff key was in its slot
+    Expects:
+        key is not UINT64_MAX - it marks an empty slot
+        the filter has at least one slot
+    Notes:
+        Will CRE if key is UINT64_MAX
+    *********************************/
+    bool testAndSet(uint64_t key)
+    {
+        assert(key != EMPTY);
+        uint64_t &slot = slots[slotOf(key)];
+        if (slot == key) return true;
+        slot = key;
+        return false;
+    }
+
+    /************ prefetch *********
+     Starts loading a key's slot into the cache
+    *********************************/
+    void prefetch(uint64_t key) const
+    {
+        __builtin_prefetch(&slots[slotOf(key)], 1);
+    }
+
+    /************ clear *********
+     Forgets every key - must be called whenever the set behind it is cleared
+    *********************************/
+    void clear()
+    {
+        std::fill(slots.begin(), slots.end(), EMPTY);
+    }
+
+private:
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+    static constexpr uint64_t MIX = 0x9E3779B97F4A7C15ULL;
+
+    int shift;
+    std::vector<uint64_t> slots;
+
+    size_t slotOf(uint64_t key) const
+    {
+        return size_t((key * MIX) >> shift);
+    }
+};
+
+#endif
@@ -0,0 +1,238 @@
+/*
+    msShape.h
+    Marble Solitaire
+
+    Board shapes. A shape only says which positions of its square grid are
+    playable and which position is empty on its default starting board.
+    msBasicBoard and msSolver are templated on a shape, and everything else
+    about a board - its grid size, the integer type that holds it, its full 
+    mask, packed key size, move table and symmetry group - is derived from 
+    the shape at compile time by ShapeTraits. Each shape therefore gets its 
+    own fully constant-folded hot paths.
+
+    Grids of up to 8x8 are held in a uint64_t, exactly like the original 7x7
+    boards, so they keep the 64 bit fast paths. Larger grids (up to 11x11) 
+    are held in an unsigned __int128, which the compiler lowers to pairs of 
+    64 bit (or SSE) operations.
+
+    Adding a shape:
+        - write a struct with the same three members as the ones below
+        - PLAYABLE must be square, with at most MAX_SHAPE_CELLS (48)
+          playable positions (the packed key of a board, see boardToBits, is
+          one bit per position, and the visited sets take keys of up to 48
+          bits)
+        - every row's playable positions must be contiguous (or the row empty)
+        - explicitly instantiate it at the bottom of msBoard.cpp and
+          msSolver.cpp
+*/
+
+#ifndef MSSHAPE_H_
+#define MSSHAPE_H_
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+// 128 bit board words - __extension__ keeps -Wpedantic quiet about __int128
+__extension__ typedef unsigned __int128 uint128_t;
+
+// the most playable positions a shape may have - one key bit each
+constexpr int MAX_SHAPE_CELLS = 48;
+
+/* The French (European) board - 37 holes */
+struct FrenchShape {
+    static constexpr bool PLAYABLE[7][7] = {
+                                                  {0,0,1,1,1,0,0},
+                                                  {0,1,1,1,1,1,0},
+                                                  {1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1},
+                                                  {0,1,1,1,1,1,0},
+                                                  {0,0,1,1,1,0,0}
+                                                 };
+    static constexpr int DEFAULT_EMPTY_ROW = 0;
+    static constexpr int DEFAULT_EMPTY_COL = 2;
+};
+
+/* The English board - 33 holes, traditionally started with the center empty */
+struct EnglishShape {
+    static constexpr bool PLAYABLE[7][7] = {
+                                                  {0,0,1,1,1,0,0},
+                                                  {0,0,1,1,1,0,0},
+                                                  {1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1},
+                                                  {0,0,1,1,1,0,0},
+                                                  {0,0,1,1,1,0,0}
+                                                 };
+    static constexpr int DEFAULT_EMPTY_ROW = 3;
+    static constexpr int DEFAULT_EMPTY_COL = 3;
+};
+
+/* Wiegleb's board - 45 holes on a 9x9 grid, started with the center empty */
+struct WieglebShape {
+    static constexpr bool PLAYABLE[9][9] = {
+                                                  {0,0,0,1,1,1,0,0,0},
+                                                  {0,0,0,1,1,1,0,0,0},
+                                                  {0,0,0,1,1,1,0,0,0},
+                                                  {1,1,1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1,1,1},
+                                                  {1,1,1,1,1,1,1,1,1},
+                                                  {0,0,0,1,1,1,0,0,0},
+                                                  {0,0,0,1,1,1,0,0,0},
+                                                  {0,0,0,1,1,1,0,0,0}
+                                                 };
+    static constexpr int DEFAULT_EMPTY_ROW = 4;
+    static constexpr int DEFAULT_EMPTY_COL = 4;
+};
+
+
+/************ transformCell *********
+ Computes where a position ends up after one of the 8 board symmetries
+
+Parameters:
+    int size      - the number of rows (and columns) of the grid
+    int t         - the symmetry, numbered like msBasicBoard::Transform
+                    (0 = DEGREE_0 ... 7 = FLIP_ANTI)
+    int r, int c  - the position to move
+    int &outR     - set to the row the position moves to
+    int &outC     - set to the column the position moves to
+Returns: void
+Notes:
+    This is the single definition of what each Transform does - the bit
+    twiddling versions in msBoard.cpp must agree with it
+*********************************/
+constexpr void transformCell(int size, int t, int r, int c, 
+                             int &outR, int &outC)
+{
+    const int M = size - 1;
+    switch (t) {
+        case 0:  outR = r;     outC = c;     break; // DEGREE_0
+        case 1:  outR = M - c; outC = r;     break; // DEGREE_90
+        case 2:  outR = M - r; outC = M - c; break; // DEGREE_180
+        case 3:  outR = c;     outC = M - r; break; // DEGREE_270
+        case 4:  outR = r;     outC = M - c; break; // FLIP_H
+        case 5:  outR = M - r; outC = c;     break; // FLIP_V
+        case 6:  outR = c;     outC = r;     break; // FLIP_DIAG
+        default: outR = M - c; outC = M - r; break; // FLIP_ANTI
+    }
+}
+
+
+/************ ShapeTraits *********
+ Everything about a board shape that is derived from its PLAYABLE grid
+
+Members:
+    SIZE       - the number of rows (and columns) of the Shape's grid
+    Word       - the unsigned integer type a board of this Shape is held in
+    Line       - the unsigned integer type one row or column is held in
+    NUM_CELLS  - the number of playable positions (and bits in a packed key)
+    NUM_MOVES  - the number of distinct jumps (src, over, dst) on the shape
+    COL_START  - COL_START[r] is the first playable column of row r
+    COL_END    - COL_END[r] is the last playable column of row r (-1 when the
+                 row has no playable positions)
+    SYMMETRIES - bit t is set iff Transform t maps the shape onto itself.
+                 Only these transforms are used to canonicalize boards
+*********************************/
+template <typename Shape>
+struct ShapeTraits {
+    static constexpr int SIZE = std::extent_v<decltype(Shape::PLAYABLE), 0>;
+    static_assert(SIZE == std::extent_v<decltype(Shape::PLAYABLE), 1>,
+                  "a shape's PLAYABLE grid must be square");
+    static_assert(SIZE * SIZE <= 128, "a shape's grid must fit in 128 bits");
+
+    using Word = std::conditional_t<SIZE * SIZE <= 64, uint64_t, uint128_t>;
+    using Line = std::conditional_t<SIZE <= 8, uint8_t, uint16_t>;
+
+  private:
+    static constexpr int countCells()
+    {
+        int n = 0;
+        for (int r = 0; r < SIZE; r++)
+            for (int c = 0; c < SIZE; c++)
+                n += Shape::PLAYABLE[r][c];
+        return n;
+    }
+
+    static constexpr bool playable(int r, int c)
+    {
+        return r >= 0 && r < SIZE && c >= 0 && c < SIZE && Shape::PLAYABLE[r][c];
+    }
+
+    static constexpr int countMoves()
+    {
+        constexpr int DR[4] = { -1, 1, 0, 0 };
+        constexpr int DC[4] = { 0, 0, -1, 1 };
+        int n = 0;
+        for (int r = 0; r < SIZE; r++)
+            for (int c = 0; c < SIZE; c++)
+                for (int d = 0; d < 4; d++)
+                    n += playable(r, c) && 
+                         playable(r + DR[d], c + DC[d]) &&
+                         playable(r + 2 * DR[d], c + 2 * DC[d]);
+        return n;
+    }
+
+    static constexpr std::array<int, SIZE> rowBounds(bool start)
+    {
+        std::array<int, SIZE> bounds{};
+        for (int r = 0; r < SIZE; r++) {
+            int first = SIZE, last = -1;
+            for (int c = 0; c < SIZE; c++) {
+                if (!Shape::PLAYABLE[r][c]) continue;
+                if (first == SIZE) first = c;
+                last = c;
+            }
+            bounds[r] = start ? (last < 0 ? 0 : first) : last;
+        }
+        return bounds;
+    }
+
+    static constexpr bool rowsContiguous()
+    {
+        for (int r = 0; r < SIZE; r++) {
+            int runs = 0;
+            for (int c = 0; c < SIZE; c++) {
+                bool startsRun = Shape::PLAYABLE[r][c] &&
+                                 (c == 0 || !Shape::PLAYABLE[r][c - 1]);
+                runs += startsRun;
+            }
+            if (runs > 1) return false;
+        }
+        return true;
+    }
+
+    static constexpr uint8_t symmetries()
+    {
+        uint8_t group = 0;
+        for (int t = 0; t < 8; t++) {
+            bool maps = true;
+            for (int r = 0; r < SIZE; r++) {
+                for (int c = 0; c < SIZE; c++) {
+                    int tr = 0, tc = 0;
+                    transformCell(SIZE, t, r, c, tr, tc);
+                    maps &= Shape::PLAYABLE[r][c] == Shape::PLAYABLE[tr][tc];
+                }
+            }
+            if (maps) group |= uint8_t(1u << t);
+        }
+        return group;
+    }
+
+  public:
+    static constexpr int NUM_CELLS = countCells();
+    static constexpr int NUM_MOVES = countMoves();
+    static constexpr std::array<int, SIZE> COL_START = rowBounds(true);
+    static constexpr std::array<int, SIZE> COL_END   = rowBounds(false);
+    static constexpr uint8_t SYMMETRIES = symmetries();
+
+    static_assert(rowsContiguous(),
+                  "every row of a shape must be one contiguous run");
+    static_assert(NUM_CELLS > 1 && NUM_CELLS <= MAX_SHAPE_CELLS,
+                  "a shape's packed key must fit in a visited set's keys");
+    static_assert(Shape::PLAYABLE[Shape::DEFAULT_EMPTY_ROW]
+                                 [Shape::DEFAULT_EMPTY_COL],
+                  "the default empty position must be playable");
+};
+
+#endif
@@ -0,0 +1,206 @@
+/*
+    msShardedSet.h
+    Marble Solitaire
+
+    A hash set of packed boards that several threads can add to at once.
+    The keys are split over 2^shardLog2 shards by the high bits of a
+    scrambled copy of the key, and each shard is an msQuotientSet behind
+    its own spinlock. Two threads only ever wait for each other when their
+    keys land in the same shard at the same time, which with 64+ shards and
+    scrambled keys is rare.
+
+    Each shard sits on its own cache lines, so threads working on different
+    shards never share a line. A shard's set grows on its own, under its
+    lock, while the other shards keep working.
+*/
+
+#ifndef MSSHARDEDSET_H_
+#define MSSHARDEDSET_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "configuration.h"
+#include "msQuotientSet.h"
+
+#if HAVE_RDTSC
+    #include <x86intrin.h>
+#endif
+
+class msShardedSet {
+
+public:
+
+    /************ msShardedSet constructor *********
+     Creates an empty set
+
+    Parameters:
+        int bits        - every key is less than 2^bits
+        int shardLog2   - the set has 2^shardLog2 shards
+        int initialLog2 - each shard starts with 2^initialLog2 slots
+    Expects:
+        bits is at most msQuotientSet::MAX_KEY_BITS
+        shardLog2 is between 0 and 16
+    Notes:
+        Will CRE if either is out of range
+    *********************************/
+    msShardedSet(int bits, int shardLog2, int initialLog2)
+        : shift(64 - shardLog2), numShards(size_t(1) << shardLog2)
+    {
+        assert(shardLog2 >= 0 && shardLog2 <= 16);
+        shards.reset(new Shard[numShards]);
+        for (size_t i = 0; i < numShards; i++) {
+            shards[i].set.reset(new msQuotientSet(bits, initialLog2));
+        }
+    }
+
+    /************ testAndSet *********
+     Adds a key to the set. Safe to call from any number of threads at once
+
+    Parameters:
+        uint64_t key - the key to add
+    Returns:
+        A bool - true if and only if the key was already in the set
+    *********************************/
+    bool testAndSet(uint64_t key)
+    {
+        Shard &shard = shardOf(key);
+        lock(shard);
+        bool hit = shard.set->testAndSet(key);
+        shard.locked.store(false, std::memory_order_release);
+        return hit;
+    }
+
+    /************ contains *********
+     Looks a key up without adding it. Takes the key's shard lock, so it is
+     safe to call while other threads are adding keys
+
+    Parameters:
+        uint64_t key - the key to look for
+    Returns:
+        A bool - true if and only if the key is in the set
+    *********************************/
+    bool contains(uint64_t key) const
+    {
+        Shard &shard = shardOf(key);
+        lock(shard);
+        bool hit = shard.set->contains(key);
+        shard.locked.store(false, std::memory_order_release);
+        return hit;
+    }
+
+    /************ prefetch *********
+     Starts loading the slot a key's probe starts at into the cache
+    
+    Notes:
+        Reads the shard's set without its lock - the slot it prefetches may
+        be stale if the shard grows meanwhile, but the prefetch is only a hint
+    *********************************/
+    void prefetch(uint64_t key) const
+    {
+        shardOf(key).set->prefetch(key);
+    }
+
+    /************ clear / size / loadFactor / bytesUsed / contention *********
+     Like msQuotientSet's, summed over every shard. contention is the number
+     of testAndSet calls that found their shard locked by another thread
+
+    Notes:
+        None of them lock - they must not run while another thread is adding
+        keys
+    *********************************/
+    void clear()
+    {
+        for (size_t i = 0; i < numShards; i++) {
+            shards[i].set->clear();
+            shards[i].contended.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t size() const
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < numShards; i++) total += shards[i].set->size();
+        return total;
+    }
+
+    double loadFactor() const
+    {
+        uint64_t slots = 0;
+        for (size_t i = 0; i < numShards; i++) {
+            slots += shards[i].set->numSlots();
+        }
+        return double(size()) / double(slots);
+    }
+
+    uint64_t bytesUsed() const
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < numShards; i++) {
+            total += shards[i].set->bytesUsed();
+        }
+        return total;
+    }
+
+    uint64_t contention() const
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < numShards; i++) {
+            total += shards[i].contended.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr uint64_t MIX = 0x9E3779B97F4A7C15ULL;
+
+    /*
+      One shard - its lock, a count of how often the lock was found taken,
+      and its set. The set itself is on the heap, so growing one shard never
+      moves another
+    */
+    struct alignas(CACHE_LINE) Shard {
+        std::atomic<bool> locked{false};
+        std::atomic<uint64_t> contended{0};
+        std::unique_ptr<msQuotientSet> set;
+    };
+
+    int shift;
+    size_t numShards;
+    std::unique_ptr<Shard[]> shards;
+
+    /************ shardOf *********
+     The shard a key belongs to - the top bits of the key times an odd
+     constant, so keys that only differ in their low bits still spread out
+    *********************************/
+    Shard &shardOf(uint64_t key) const
+    {
+        if (numShards == 1) return shards[0];
+        return shards[(key * MIX) >> shift];
+    }
+
+    /************ lock *********
+     Takes a shard's spinlock. Waiting threads spin on a plain load, so they
+     don't keep stealing the line from the thread that holds the lock
+    *********************************/
+    static void lock(Shard &shard)
+    {
+        if (!shard.locked.exchange(true, std::memory_order_acquire)) return;
+
+        shard.contended.fetch_add(1, std::memory_order_relaxed);
+        do {
+            while (shard.locked.load(std::memory_order_relaxed)) {
+                #if HAVE_RDTSC
+                    _mm_pause();
+                #else
+                    std::this_thread::yield();
+                #endif
+            }
+        } while (shard.locked.exchange(true, std::memory_order_acquire));
+    }
+};
+
+#endif
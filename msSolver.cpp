@@ -23,13 +23,24 @@
 
 #include "msSolver.h"
 #include "msBoard.h"
-#include <stack>
-#include <optional>
+#include <array>
+#include <cassert>
+#include <type_traits>
 #include <utility>
 #include <sys/mman.h>
 #include "msBitmap.h"
+#include "msCycles.h"
+#include "msMemory.h"
+#include "msTrace.h"
 #include "robin_hood.h"
 
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <tuple>
+
 namespace {
 
     /************************** structs and types: ****************************/
@@ -39,22 +50,101 @@ namespace {
         be played on the board during our DFS 'solve' algorithm
 
     Members: 
-        Board board - the board that we are playing on
-        size_t moveIndex  - the index of the current move we are executing
-        size_t moveEnd    - the index of the last valid move on our board
-        size_t movesStart - the index of the first valid move on our board
+        Board board         - the board that we are playing on
+        Transform transform - every transform applied between the start board
+                              and this one, composed into one (board is the
+                              start board's path with transform applied)
+        uint8_t moveIndex   - the index in moves of the next move to play
+        MoveList moves      - every valid move on board
+        MoveSet sleep       - this frame's sleep set: moves that need not be
+                              played here (see runDFS)
+        MoveSet tried       - the moves already played from this frame
+        Board children[i]   - the board moves[i] leads to, canonicalized if 
+                              the policy memoizes it (see expandChildren)
+        Transform childTransforms[i] - the transform that canonicalized
+                                       children[i]
+        uint8_t childStabilizers[i]  - children[i]'s symmetry group
+        bool childSeen[i]            - children[i] was already in the 
+                                       visited set when the frame was pushed
+
+        Frames live in one fixed array indexed by depth, and are plain data, 
+        so pushing and popping never allocates. The move that led to a frame
+        is the one its parent (the frame below it) played last - 
+        parent.moves[parent.moveIndex - 1] - so it is not stored again
+    *********************************/
+    constexpr size_t CACHE_LINE = 64;
+
+    template <typename Board>
+    struct alignas(CACHE_LINE) StackFrame {
+        Board board;
+        typename Board::Transform transform;
+        uint8_t moveIndex;
+        typename Board::MoveList moves;
+        typename Board::MoveSet sleep;
+        typename Board::MoveSet tried;
+        Board children[Board::NUM_MOVES];
+        typename Board::Transform childTransforms[Board::NUM_MOVES];
+        uint8_t childStabilizers[Board::NUM_MOVES];
+        bool childSeen[Board::NUM_MOVES];
+    };
 
-        All the indices mentioned above correspond to a shared buffer of moves
+    /*
+      A start board has at most NUM_CELLS - 1 marbles, so a path never has 
+      more than NUM_CELLS - 2 moves and NUM_CELLS - 1 frames
+    */
+    template <typename Board>
+    using FrameStack = std::array<StackFrame<Board>, Board::NUM_CELLS>;
+
+    /************ MemoPolicy *********
+     Decides which boards are canonicalized and put in the visited set
+
+    Members:
+        int startMarbles - the number of marbles on the start board, so a 
+                           board at depth d has startMarbles - d marbles
+        int floor        - boards with this many marbles or fewer are 
+                           neither canonicalized nor memoized
+        bool settled     - true once floor will not be raised any further
+        probes, hits     - visited-set probes of boards with floor + 1 
+                           marbles, and how many of them were hits
+        misses, children - the new boards among those probes, and how many
+                           moves they generated
+
+        Only ever raises floor (see ADAPTIVE_MEMO in configuration.h), so a
+        board is memoized on the way down exactly when it would be on any 
+        later visit. Mixing memoized and unmemoized marble counts is always
+        sound - the visited set only ever holds boards that were searched
     *********************************/
-    struct StackFrame {
-        msBoard board;
-        size_t moveIndex;
-        size_t moveEnd;
-        size_t movesStart;   
+    struct MemoPolicy {
+        int startMarbles;
+        int floor = MEMO_MIN_MARBLES - 1;
+        bool settled = !ADAPTIVE_MEMO;
+        uint64_t probes = 0, hits = 0, misses = 0, children = 0;
+
+        bool memoize(int marbles) const { 
+            return marbles > floor; 
+        }
 
-        std::vector<msBoard::Transform> transforms;
+        void observeProbe(int marbles, bool hit) {
+            if (settled || marbles != floor + 1) return;
+            probes++;
+            hits += hit;
+            misses += !hit;
+            if (probes < MEMO_WARMUP_PROBES) return;
+
+            // hits * (1 + children / misses) < MEMO_MIN_BENEFIT% of probes
+            uint64_t saved = hits * (misses + children) * 100;
+            if (saved >= uint64_t(MEMO_MIN_BENEFIT) * probes * misses) {
+                settled = true;
+                return;
+            }
+            floor++;
+            settled = floor + 1 >= startMarbles;
+            probes = hits = misses = children = 0;
+        }
 
-        std::optional<msBoard::Move> incomingMove; 
+        void observeChildren(int marbles, size_t count) {
+            if (!settled && marbles == floor + 1) children += count;
+        }
     };
 
     /************ IdentityHash *********
@@ -68,133 +158,503 @@ namespace {
     };
 
     /******************************* Constants: *******************************/
-    constexpr uint64_t BIT_COUNT  = 1ULL << 37;
+    // one bit for every possible packed board (2^37 for French boards)
+    template <typename Board>
+    constexpr uint64_t BIT_COUNT  = 1ULL << Board::NUM_CELLS;
 
+    /*
+      Boards with more cells than the French board (like Wiegleb's 45) would 
+      need a bitmap far larger than any machine's memory, so they never use
+      one
+    */
+    constexpr int MAX_BITMAP_CELLS = 37;
 
+    static_assert(MAX_SHAPE_CELLS <= msQuotientSet::MAX_KEY_BITS,
+                  "every shape's keys must fit in the quotient set");
 
-    const int INIT_MOVES_SIZE = 64;
-    const int START_MOVE_IDX = 0;
-    const int FIRST_MOVE_IDX = 0;
+    template <typename Board, msBackend Backend>
+    using SeenSet = msBitmap<Board, decltype(&Board::boardToBits), Backend>;
 
+    /*
+      The most a quotient set costs per board: its slots are at most 4
+      bytes, and at the lowest load it runs at (45%, right after growing)
+      that is 4 / 0.45 = 8.9 bytes a board, rounded up to 9
+    */
+    constexpr double QUOTIENT_BYTES_PER_BOARD = 9.0;
 
-    /************************* Function declarations: *************************/
-    std::vector<msBoard::Move> runDFS( 
-                    std::stack<StackFrame> dfs,
-                    msBitmap<msBoard, decltype(&msBoard::boardToBits)>& seen,
-                    std::vector<msBoard::Move> moves);
+    // the backend setBackend asked for - AUTO unless overridden
+    msSolver::Backend requestedBackend = msSolver::Backend::AUTO;
 
-    std::vector<msBoard::Move> getMoveOrder(std::stack<StackFrame> dfs);
+
+
+    const int START_FRAME = 0;
+
+
+    /************************* Function declarations: *************************/
+    template <typename Board, typename Seen>
+    std::vector<typename Board::Move> runDFS( 
+                    FrameStack<Board> &frames,
+                    Seen& seen,
+                    MemoPolicy &policy,
+                    msSolver::SolverStats &stats);
+
+    template <typename Board>
+    std::vector<typename Board::Move> getMoveOrder(
+                                        const FrameStack<Board> &frames,
+                                        int top);
+
+    template <typename Board>
+    void generateMoves(const Board &board, uint8_t stabilizer,
+                       typename Board::MoveList &moves,
+                       msSolver::SolverStats &stats);
+
+    template <typename Board, typename Seen>
+    void expandChildren(StackFrame<Board> &frame, int marbles,
+                        const Seen &seen, const MemoPolicy &policy,
+                        msSolver::SolverStats &stats);
+
+    template <typename Shape>
+    msSolver::Backend chooseBackend(int marbles);
+
+    template <typename Board, msBackend Backend>
+    std::vector<typename Board::Move> solveWith(
+                    const Board &startCanonical,
+                    typename Board::Transform startTransform,
+                    uint8_t stabilizer,
+                    msSolver::SolverStats &counters);
 
 
     /******************************* Functions: *******************************/
+
+    /************ startTimer / stopTimer *********
+     Time one phase of the search for SolverStats. Both compile to nothing 
+     when COLLECT_SOLVER_STATS is 0
+
+    Parameters: 
+        uint64_t &total - the SolverStats counter to add the elapsed cycles to
+        uint64_t start  - the value startTimer returned
+    *********************************/
+    inline uint64_t startTimer()
+    {
+        if constexpr (COLLECT_SOLVER_STATS) return readCycles();
+        return 0;
+    }
+
+    inline void stopTimer(uint64_t &total, uint64_t start)
+    {
+        if constexpr (COLLECT_SOLVER_STATS) total += readCycles() - start;
+        (void) total;
+        (void) start;
+    }
     
+    /************ generateMoves *********
+     Fills a frame's MoveList with the moves the search plays from a board
+
+    Parameters: 
+        const Board &board  - the canonical board to generate moves for
+        uint8_t stabilizer  - board's symmetry group from getCanonicalBits 
+                              (ignored if ENABLE_STABILIZER_PRUNING is 0)
+        MoveList &moves     - the list to fill
+        SolverStats &stats  - the counters to update - only touched if 
+                              COLLECT_SOLVER_STATS
+    Returns: void
+    *********************************/
+    template <typename Board>
+    void generateMoves(const Board &board, uint8_t stabilizer,
+                       typename Board::MoveList &moves,
+                       msSolver::SolverStats &stats)
+    {
+        if constexpr (ENABLE_STABILIZER_PRUNING) {
+            board.validMoves(moves, stabilizer);
+            if constexpr (COLLECT_SOLVER_STATS) 
+                stats.symmetricNodes += stabilizer != (1 << Board::DEGREE_0);
+        } else {
+            board.validMoves(moves);
+            (void) stabilizer;
+            (void) stats;
+        }
+    }
+
+    /************ expandChildren *********
+     Computes the child board of every move of a frame at once, and starts
+     loading each one's visited-set entry into the cache
+
+    Parameters: 
+        StackFrame<Board> &frame - the frame, with its moves and sleep set 
+                                   already filled in
+        int marbles              - the number of marbles on the children
+        const Seen &seen         - the visited set the children will be
+                                   tested against
+        const MemoPolicy &policy - decides whether the children are
+                                   canonicalized
+        SolverStats &stats       - the counters to update - only touched if 
+                                   COLLECT_SOLVER_STATS
+    Returns: void
+    Notes:
+        The memoized children are handed to the visited set in one batch. 
+        By default it is only prefetched (ENABLE_CHILD_PREFETCH): most 
+        children are hits, so the siblings of one frame are usually tested 
+        right after each other, and their cache misses (one per child, on a
+        set far bigger than the cache) overlap instead of being paid one at
+        a time. With ENABLE_BATCHED_PROBES they are looked up right away 
+        instead, and the ones already there are marked in childSeen - 
+        nothing is added, runDFS still adds each new child when it gets to
+        it. Children asleep in the frame are never played, so they are 
+        skipped
+    *********************************/
+    template <typename Board, typename Seen>
+    void expandChildren(StackFrame<Board> &frame, int marbles,
+                        const Seen &seen, const MemoPolicy &policy,
+                        msSolver::SolverStats &stats)
+    {
+        const bool memoize = policy.memoize(marbles);
+        uint64_t timer = startTimer();
+        Board batch[Board::NUM_MOVES];
+        uint8_t batchIndex[Board::NUM_MOVES];
+        size_t batchSize = 0;
+
+        for (size_t i = 0; i < frame.moves.size(); i++) {
+            const typename Board::Move m = frame.moves[i];
+            if (ENABLE_SLEEP_SETS && frame.sleep.contains(m)) continue;
+
+            Board next = frame.board.applyMove(m);
+            if (!memoize) {
+                frame.children[i] = next;
+                frame.childTransforms[i] = Board::DEGREE_0;
+                frame.childStabilizers[i] = 1 << Board::DEGREE_0;
+                continue;
+            }
+            uint8_t stabilizer = 1 << Board::DEGREE_0;
+            std::tie(frame.children[i], frame.childTransforms[i]) = 
+                    next.getCanonicalBits(
+                            ENABLE_STABILIZER_PRUNING ? &stabilizer : nullptr);
+            frame.childStabilizers[i] = stabilizer;
+            frame.childSeen[i] = false;
+            batch[batchSize] = frame.children[i];
+            batchIndex[batchSize++] = uint8_t(i);
+        }
+        stopTimer(stats.canonicalCycles, timer);
+
+        if constexpr (ENABLE_BATCHED_PROBES) {
+            if (batchSize == 0) return;
+            timer = startTimer();
+            bool hits[Board::NUM_MOVES];
+            {
+                TRACE_SCOPE(TEST_AND_SET);
+                seen.testBatch(batch, batchSize, hits);
+            }
+            for (size_t k = 0; k < batchSize; k++) {
+                frame.childSeen[batchIndex[k]] = hits[k];
+            }
+            stopTimer(stats.seenCycles, timer);
+        } else if constexpr (ENABLE_CHILD_PREFETCH) {
+            seen.prefetchBatch(batch, batchSize);
+        }
+    }
+
     /************ runDFS *********
      Performs the dfs search algorithm and finds a solution to the given
      board state
     
     Parameters: 
-        std::stack<StackFrame> dfs:
-            - dfs is the stack we use to keep track of board states
-        msBitmap<msBoard, &msBoard::boardToBits> seen:
-            - bitmap holds all the 'seen' boards so we don't revisit them
-        std::vector<msBoard::Move> moves
-            - moves holds all moves to try throughout the solution search
+        FrameStack<Board> &frames:
+            - the stack we use to keep track of board states, indexed by depth
+        Seen &seen:
+            - the visited set (an msBitmap with any backend) - holds all the
+              'seen' boards so we don't revisit them
+        MemoPolicy &policy:
+            - decides which children are canonicalized and memoized, and is
+              fed the hit rates it decides on
+        msSolver::SolverStats &stats
+            - the counters to update - only touched if COLLECT_SOLVER_STATS
     Returns: 
         std::vector<msBoard::Move> - a vector of Moves that hold the valid 
                                      solution to the original board state - 
                                      all transformation considerations should be
                                      ignored - they're removed by return-time
     Expects: 
-        dfs should hold the initial StackFrame
+        frames[START_FRAME] should hold the initial StackFrame
         bitmap / set should be cleared
-        moves should hold the initial valid moves of the board
     Notes: Will return incorrect results if not called correctly - should really
            only be used by the solve function
+
+           Sleep sets (ENABLE_SLEEP_SETS): if a and b are both legal and do
+           not interfere, then playing a then b and b then a reach the same
+           board. So once a frame has tried a, its later children never play
+           a again - a child reached by b starts with every tried move that 
+           commutes with b asleep. Sleep sets are only passed down one level:
+           a frame never hands its own sleep set on to its children. That 
+           keeps the reduction sound with a visited set that stores boards 
+           only - every skipped board was already reached by a sibling whose
+           search finished (or was cut short by the visited set, which only
+           happens for boards searched even earlier)
+
+           Stabilizer pruning (ENABLE_STABILIZER_PRUNING): when a symmetry 
+           maps a board onto itself, it also maps the board's moves onto 
+           each other, and moves in one orbit reach the same canonical child.
+           Only one of them is played. It only ever drops moves whose child
+           is played anyway, so it is sound together with sleep sets
+
+           A frame's children are all computed, and handed to the visited 
+           set in one batch, when it is pushed (see expandChildren). The 
+           batch is read only: each new child is only added when the search
+           gets to it. Adding a whole batch up front would make the visited
+           set hold boards whose search has not even started, which the 
+           sleep set argument above does not allow. A child a batched lookup
+           found (ENABLE_BATCHED_PROBES) is known to be seen and skips its 
+           testAndSet
     *********************************/
-    std::vector<msBoard::Move> runDFS(
-                    std::stack<StackFrame> dfs,
-                    msBitmap<msBoard, decltype(&msBoard::boardToBits)>& seen,
-                    std::vector<msBoard::Move> moves)
+    template <typename Board, typename Seen>
+    std::vector<typename Board::Move> runDFS(
+                    FrameStack<Board> &frames,
+                    Seen& seen,
+                    MemoPolicy &policy,
+                    msSolver::SolverStats &stats)
     {
-        while (!dfs.empty()) {
-            StackFrame &top = dfs.top();
-            if (top.moveIndex >= top.moveEnd) {
-                moves.reserve(top.movesStart);
-                dfs.pop();
+        int top = START_FRAME;
+
+        while (top >= START_FRAME) {
+            StackFrame<Board> &frame = frames[top];
+            if (frame.moveIndex >= frame.moves.size()) {
+                TRACE_SCOPE(STACK_POP);
+                top--;
                 continue;
             }
-            const msBoard::Move m = moves[top.moveIndex++];
-            msBoard nextBoard = top.board.applyMove(m);
+            const typename Board::Move m = frame.moves[frame.moveIndex++];
+            if constexpr (ENABLE_SLEEP_SETS) {
+                if (frame.sleep.contains(m)) {
+                    if constexpr (COLLECT_SOLVER_STATS) stats.sleepSkips++;
+                    continue;
+                }
+                frame.tried.insert(m);
+            }
+            const size_t childIndex = frame.moveIndex - 1;
+            const size_t depth = top + 1;
+            const int marbles = policy.startMarbles - int(depth);
+
+            /*
+              Boards the policy doesn't memoize are not canonicalized either
+              - the canonical form is only worth its cost as a visited-set key.
+              The policy only ever stops memoizing a marble count, so a child
+              it memoizes now was canonicalized by expandChildren
+            */
+            const Board &canonical = frame.children[childIndex];
+            const typename Board::Transform transform = 
+                                        frame.childTransforms[childIndex];
+            const uint8_t stabilizer = frame.childStabilizers[childIndex];
+            bool seenBefore = false;
+            if (policy.memoize(marbles)) {
+                uint64_t timer = startTimer();
+                {
+                    TRACE_SCOPE(TEST_AND_SET);
+                    seenBefore = frame.childSeen[childIndex] || 
+                                 seen.testAndSet(canonical);
+                }
+                stopTimer(stats.seenCycles, timer);
+                policy.observeProbe(marbles, seenBefore);
+                if constexpr (COLLECT_SOLVER_STATS) stats.seenProbes++;
+            }
 
-            auto [canonical, transform] = nextBoard.getCanonicalBits();
+            if constexpr (COLLECT_SOLVER_STATS) {
+                stats.nodesExpanded++;
+                (seenBefore ? stats.seenHits : stats.seenMisses)[depth]++;
+            }
+            if (seenBefore) continue;
 
-            if (seen.testAndSet(canonical)) continue;
+            // A board with two marbles that can never leave is already lost
+            if constexpr (ENABLE_DEAD_MARBLE_PRUNING) {
+                if (canonical.numDeadMarbles() >= 2) {
+                    if constexpr (COLLECT_SOLVER_STATS) stats.deadPrunes++;
+                    continue;
+                }
+            }
+            if constexpr (ENABLE_MERSON_PRUNING) {
+                if (canonical.isSplitByMersonRegion()) {
+                    if constexpr (COLLECT_SOLVER_STATS) stats.mersonPrunes++;
+                    continue;
+                }
+            }
 
-            // Generate moves for the next step
-            size_t start = moves.size();
-            canonical.validMoves(moves);
-            size_t end = moves.size();
-            std::vector<msBoard::Transform> newTrans = top.transforms;
-            if (transform != msBoard::DEGREE_0) {
-                newTrans.push_back(transform);
+            // Generate moves for the next step straight into its frame
+            assert(top + 1 < int(frames.size()));
+            StackFrame<Board> &child = frames[top + 1];
+            uint64_t timer = startTimer();
+            generateMoves(canonical, stabilizer, child.moves, stats);
+            stopTimer(stats.moveGenCycles, timer);
+            policy.observeChildren(marbles, child.moves.size());
+
+            if constexpr (COLLECT_SOLVER_STATS) {
+                stats.nodesByMarbles[marbles]++;
+                stats.movesByMarbles[marbles] += child.moves.size();
+                stats.maxStackDepth = std::max(stats.maxStackDepth, 
+                                               int(depth + 1));
             }
 
-            if (nextBoard.hasWon()) {
-                dfs.emplace(StackFrame{ canonical, start, end, start, newTrans, 
-                                        m });
-                return getMoveOrder(dfs);  
+            {
+                TRACE_SCOPE(STACK_PUSH);
+                child.board = canonical;
+                child.transform = Board::composeTransforms(frame.transform, 
+                                                           transform);
+                child.moveIndex = 0;
+                if constexpr (ENABLE_SLEEP_SETS) {
+                    typename Board::MoveSet sleep = frame.tried;
+                    sleep.removeAll(Board::interferingMoves(m));
+                    child.sleep = Board::transformMoves(sleep, transform);
+                    child.tried.clear();
+                }
+                top++;
+            }
+            expandChildren(child, marbles - 1, seen, policy, stats);
+
+            if (canonical.hasWon()) {
+                return getMoveOrder<Board>(frames, top);  
             }
-            dfs.emplace(StackFrame{ canonical, start, end, start, newTrans, m });
         }
         return {};
     }
 
     /************ getMoveOrder *********
-     Takes the stack from our dfs solve algorithm and retrieves the move 
-     order that solved the board
+     Reads the move order that solved the board off of the dfs stack
     
     Parameters: 
-        std::stack<StackFrame> stack - contains the entire stack that we used
-                                       during the solve algorithm
+        const FrameStack<Board> &frames - the stack that we used during the
+                                          solve algorithm
+        int top                         - the index of the winning frame
     Returns: 
         A std::vector<msBoard::Move> that contains all the moves needed to solve
         the original board given to function solve
+    Notes:
+        Each frame's last played move was played on its own (transformed) 
+        board, so it is undone with that frame's composed transform
     *********************************/
-    std::vector<msBoard::Move> getMoveOrder(std::stack<StackFrame> stack) {
-        std::vector<msBoard::Move> revSolution;
-        std::vector<std::vector<msBoard::Transform>> transforms;
-        msBoard dummy;
-        
-        // Convert stack to vector so we can access previous elements
-        std::vector<StackFrame> frames;
-        while (!stack.empty()) {
-            frames.push_back(stack.top());
-            stack.pop();
-        }
-        // get transforms
-        for (size_t i = 0; i < frames.size(); i++) {
-            if (frames[i].incomingMove) {
-                revSolution.push_back(*frames[i].incomingMove);
-                
-                // Use the parent frame's transforms
-                if (i + 1 < frames.size()) {
-                    transforms.push_back(frames[i + 1].transforms);
-                } else {
-                    transforms.push_back(std::vector<msBoard::Transform>());
-                }
-            }
+    template <typename Board>
+    std::vector<typename Board::Move> getMoveOrder(
+                                        const FrameStack<Board> &frames,
+                                        int top) {
+        std::vector<typename Board::Move> solution;
+        solution.reserve(top);
+        Board dummy;
+
+        for (int d = START_FRAME; d < top; d++) {
+            const StackFrame<Board> &frame = frames[d];
+            typename Board::Move m = frame.moves[frame.moveIndex - 1];
+            dummy.undoTransform(m, frame.transform);
+            solution.push_back(m);
         }
-        // undo transforms
-        for (size_t i = 0; i < revSolution.size(); i++) {
-            msBoard::Move curr = revSolution[i];
-            for (int j = transforms[i].size() - 1; j >= 0; j--) {  
-                dummy.undoTransform(curr, transforms[i][j]);
-            }
-            revSolution[i] = curr;
+        return solution;
+    }
+
+    /************ chooseBackend *********
+     Picks the visited set for one solve, unless setBackend forced one
+
+    Parameters: 
+        int marbles - the number of marbles on the start board
+    Returns: 
+        A msSolver::Backend - BITMAP or QUOTIENT_SET, or whatever setBackend 
+                              asked for (BITMAP only if the shape allows one)
+    Notes:
+        The bitmap needs 2^NUM_CELLS bits no matter how few boards are 
+        stored, and is cleared in full before every solve. It is picked only
+        when it fits in MEMORY_BUDGET_PERCENT of the memory msMemory reports
+        as usable, and the quotient set could need more than that - the size
+        hint is every board with MEMO_MIN_MARBLES to marbles marbles, one per
+        symmetry class, at QUOTIENT_BYTES_PER_BOARD. Starts with few marbles
+        never store enough boards to pay for clearing the bitmap.
+        Logs the choice to std::clog whenever it changes (LOG_BACKEND_CHOICE)
+    *********************************/
+    template <typename Shape>
+    msSolver::Backend chooseBackend(int marbles)
+    {
+        using msSolver::Backend;
+        using Board = msBasicBoard<Shape>;
+        constexpr bool bitmapAllowed = Board::NUM_CELLS <= MAX_BITMAP_CELLS;
+        const double bitmapBytes = double(BIT_COUNT<Board>) / 8;
+        const double budget = double(msMemory::usableBytes()) * 
+                              MEMORY_BUDGET_PERCENT / 100;
+
+        double boards = 0, binomial = 1;
+        for (int k = 1; k <= marbles; k++) {
+            binomial = binomial * (Board::NUM_CELLS - k + 1) / k;
+            if (k >= MEMO_MIN_MARBLES) boards += binomial;
+        }
+        boards /= __builtin_popcount(ShapeTraits<Shape>::SYMMETRIES);
+        const double quotientBytes = boards * QUOTIENT_BYTES_PER_BOARD;
+
+        Backend backend = requestedBackend;
+        if (backend == Backend::AUTO) {
+            bool useBitmap = bitmapAllowed && bitmapBytes <= budget && 
+                             quotientBytes > bitmapBytes;
+            backend = useBitmap ? Backend::BITMAP : Backend::QUOTIENT_SET;
+        } else if (backend == Backend::BITMAP && !bitmapAllowed) {
+            backend = Backend::QUOTIENT_SET;
+        }
+
+        static Backend lastLogged = Backend::AUTO;
+        if (LOG_BACKEND_CHOICE && backend != lastLogged) {
+            constexpr double GIB = 1024.0 * 1024.0 * 1024.0;
+            std::clog << std::fixed << std::setprecision(1)
+                      << "msSolver: visited set is the " 
+                      << msSolver::backendName(backend)
+                      << (requestedBackend == Backend::AUTO ? "" : " (forced)")
+                      << " - " << budget / GIB << " GiB budget, bitmap " 
+                      << bitmapBytes / GIB << " GiB, quotient set up to "
+                      << quotientBytes / GIB << " GiB" << std::endl;
+            lastLogged = backend;
+        }
+        return backend;
+    }
+
+    /************ solveWith *********
+     Runs the search from a canonical start board with one visited set
+
+    Parameters: 
+        const Board &startCanonical - the canonical start board
+        Transform startTransform    - the transform that canonicalized it
+        uint8_t stabilizer          - its symmetry group
+        SolverStats &counters       - the counters to fill in
+    Returns: 
+        A std::vector<msBoard::Move> - the solution, as solve returns it
+    Notes:
+        Each backend's set is made the first time it is used and kept for
+        every later solve, so nothing is allocated again
+    *********************************/
+    template <typename Board, msBackend Backend>
+    std::vector<typename Board::Move> solveWith(
+                    const Board &startCanonical,
+                    typename Board::Transform startTransform,
+                    uint8_t stabilizer,
+                    msSolver::SolverStats &counters)
+    {
+        static SeenSet<Board, Backend> seen(BIT_COUNT<Board>, 
+                                            &Board::boardToBits);
+        FrameStack<Board> frames;
+
+        seen.clear();
+
+        StackFrame<Board> &start = frames[START_FRAME];
+        start.board = startCanonical;
+        start.transform = startTransform;
+        start.moveIndex = 0;
+        start.sleep.clear();
+        start.tried.clear();
+        generateMoves(startCanonical, stabilizer, start.moves, counters);
+        if constexpr (COLLECT_SOLVER_STATS) {
+            int marbles = startCanonical.numMarbles();
+            counters.nodesByMarbles[marbles]++;
+            counters.movesByMarbles[marbles] += start.moves.size();
+            counters.maxStackDepth = 1;
         }
-        // Reverse to get forward solution
-        std::reverse(revSolution.begin(), revSolution.end());
-        return revSolution;
+
+        MemoPolicy policy{ startCanonical.numMarbles() };
+        expandChildren(start, policy.startMarbles - 1, seen, policy, counters);
+        std::vector<typename Board::Move> solution = runDFS(frames, seen, 
+                                                            policy, counters);
+
+        counters.seenSize = seen.size();
+        counters.memoFloor = policy.floor;
+        counters.seenLoadFactor = seen.loadFactor();
+        counters.recentHits = seen.recentHits();
+        return solution;
     }
 }
 
@@ -203,42 +663,184 @@ namespace {
 
 Parameters: 
     const Board &startBoard - a constant reference to the board to solve
+    SolverStats *stats      - if not nullptr, filled in with the statistics
+                              of this solve (see SolverStats)
 Returns: 
     A std::vector<msBoard::Move> that contains all the moves needed to solve
     the original board given to function solve
 Notes: 
     Will return an empty vector if the board is unsolvable
+    The visited set is picked for every solve (see chooseBackend)
 *********************************/
-std::vector<msBoard::Move> msSolver::solve(const msBoard& startBoard)
+template <typename Shape>
+std::vector<typename msBasicBoard<Shape>::Move> 
+        msSolver::solve(const msBasicBoard<Shape>& startBoard, 
+                        SolverStats *stats)
 {
-    static msBitmap<msBoard, decltype(&msBoard::boardToBits)> 
-                                        seen(BIT_COUNT, &msBoard::boardToBits);
+    using Board = msBasicBoard<Shape>;
+    static_assert(std::is_trivially_copyable_v<StackFrame<Board>>,
+                  "stack frames must stay plain data");
 
-    std::vector<msBoard::Transform> transforms;
-    std::vector<msBoard::Move> moves;
+    SolverStats local;
+    SolverStats &counters = stats ? *stats : local;
+    counters = SolverStats();
 
-    seen.clear();
+    // get initial canonical board and transform - start algorithm
+    uint8_t stabilizer = 0;
+    auto [startCanonical, startTransform] = startBoard.getCanonicalBits(
+                            ENABLE_STABILIZER_PRUNING ? &stabilizer : nullptr);
 
-    moves.reserve(INIT_MOVES_SIZE);
-    std::stack<StackFrame> dfs;
+    if (ENABLE_DEAD_MARBLE_PRUNING && startCanonical.numDeadMarbles() >= 2) {
+        return {};
+    }
 
-    // get initial canonical board and transform - start algorithm
-    auto [startCanonical, startTransform] = startBoard.getCanonicalBits();
+    counters.backend = chooseBackend<Shape>(startCanonical.numMarbles());
+    if constexpr (Board::NUM_CELLS <= MAX_BITMAP_CELLS) {
+        if (counters.backend == Backend::BITMAP) {
+            return solveWith<Board, BITMAP_BACKEND>(startCanonical, 
+                                        startTransform, stabilizer, counters);
+        }
+    }
+    if (counters.backend == Backend::HASH_SET) {
+        return solveWith<Board, HASH_SET_BACKEND>(startCanonical, 
+                                        startTransform, stabilizer, counters);
+    }
+    return solveWith<Board, QUOTIENT_BACKEND>(startCanonical, startTransform,
+                                              stabilizer, counters);
+}
+
+/************ setBackend *********
+ Forces every later solve to use one visited set (AUTO goes back to 
+ picking one per solve)
 
-    if (startTransform != msBoard::DEGREE_0) {
-        transforms.push_back(startTransform);
+Parameters: 
+    Backend backend - the visited set to use
+Returns: void
+Notes:
+    BITMAP is ignored for shapes with more than 37 cells
+*********************************/
+void msSolver::setBackend(Backend backend)
+{
+    requestedBackend = backend;
+}
+
+/************ parseBackend / backendName *********
+ Convert between a Backend and its name - "auto", "bitmap", "quotient" or 
+ "hash"
+
+Parameters: 
+    const char *name - the name to look up
+    Backend &backend - set to the Backend called name
+Returns: 
+    parseBackend: A bool - false if name is not one of the four
+    backendName:  A const char * - the name of backend
+*********************************/
+bool msSolver::parseBackend(const char *name, Backend &backend)
+{
+    for (Backend b : { Backend::AUTO, Backend::BITMAP, Backend::QUOTIENT_SET,
+                       Backend::HASH_SET }) {
+        if (std::strcmp(name, backendName(b)) == 0) {
+            backend = b;
+            return true;
+        }
     }
-    startCanonical.validMoves(moves);
-    dfs.emplace(StackFrame{ startCanonical, START_MOVE_IDX, moves.size(), 
-                            FIRST_MOVE_IDX, transforms, 
-                            std::nullopt });
+    return false;
+}
 
-    return runDFS(dfs, seen, moves);
+const char *msSolver::backendName(Backend backend)
+{
+    switch (backend) {
+        case Backend::BITMAP:       return "bitmap";
+        case Backend::QUOTIENT_SET: return "quotient";
+        case Backend::HASH_SET:     return "hash";
+        default:                    return "auto";
+    }
 }
 
 
 
-bool msSolver::isSolvable(const msBoard& start)
+template <typename Shape>
+bool msSolver::isSolvable(const msBasicBoard<Shape>& start)
 {
     return !solve(start).empty();
-}
\ No newline at end of file
+}
+
+/************ SolverStats::print *********
+ Prints the statistics of a solve in a human readable table
+
+Parameters: 
+    std::ostream &stream - the stream we print to
+Returns: void
+Notes:
+    Only prints the visited-set summary if COLLECT_SOLVER_STATS is 0, since
+    every other counter would be 0
+*********************************/
+void msSolver::SolverStats::print(std::ostream &stream) const
+{
+    stream << "visited set (" << backendName(backend) << "): " << seenSize 
+           << " boards, load factor "
+           << std::fixed << std::setprecision(3) << seenLoadFactor 
+           << ", boards with " << memoFloor << " or fewer marbles not stored\n";
+    if constexpr (RECENT_FILTER_LOG2 > 0) {
+        stream << "recent filter hits: " << recentHits;
+        if constexpr (COLLECT_SOLVER_STATS) {
+            uint64_t hits = 0;
+            for (uint64_t h : seenHits) hits += h;
+            stream << " (" << std::setprecision(1) 
+                   << (hits ? 100.0 * recentHits / hits : 0.0) 
+                   << "% of visited-set hits)";
+        }
+        stream << '\n';
+    }
+
+    if constexpr (!COLLECT_SOLVER_STATS) {
+        stream << "(set COLLECT_SOLVER_STATS to 1 in configuration.h for "
+               << "per-node statistics)\n";
+        return;
+    }
+
+    uint64_t totalCycles = canonicalCycles + moveGenCycles + seenCycles;
+    auto percent = [totalCycles](uint64_t cycles) {
+        return totalCycles ? 100.0 * cycles / totalCycles : 0.0;
+    };
+    stream << "nodes expanded: " << nodesExpanded << '\n'
+           << "visited-set probes: " << seenProbes << '\n'
+           << "moves skipped by sleep sets: " << sleepSkips << '\n'
+           << "symmetric boards: " << symmetricNodes << '\n'
+           << "boards with dead marbles: " << deadPrunes << '\n'
+           << "boards split by a Merson region: " << mersonPrunes << '\n'
+           << "max stack depth: " << maxStackDepth << '\n'
+           << "cycles: canonicalization " << canonicalCycles << " ("
+           << std::setprecision(1) << percent(canonicalCycles) << "%), "
+           << "move generation " << moveGenCycles << " ("
+           << percent(moveGenCycles) << "%), "
+           << "visited set " << seenCycles << " ("
+           << percent(seenCycles) << "%)\n";
+
+    stream << "\ndepth       hits     misses\n";
+    for (int d = 0; d <= MAX_DEPTH; d++) {
+        if (!seenHits[d] && !seenMisses[d]) continue;
+        stream << std::setw(5) << d << std::setw(11) << seenHits[d] 
+               << std::setw(11) << seenMisses[d] << '\n';
+    }
+
+    stream << "\nmarbles      nodes  branching\n";
+    for (int n = MAX_DEPTH; n >= 0; n--) {
+        if (!nodesByMarbles[n]) continue;
+        stream << std::setw(7) << n << std::setw(11) << nodesByMarbles[n]
+               << std::setw(11) << std::setprecision(2) 
+               << double(movesByMarbles[n]) / nodesByMarbles[n] << '\n';
+    }
+}
+
+
+/************************ Explicit instantiations *****************************/
+template std::vector<msBoard::Move> 
+    msSolver::solve<FrenchShape>(const msBoard&, SolverStats*);
+template std::vector<msEnglishBoard::Move> 
+    msSolver::solve<EnglishShape>(const msEnglishBoard&, SolverStats*);
+template std::vector<msWieglebBoard::Move> 
+    msSolver::solve<WieglebShape>(const msWieglebBoard&, SolverStats*);
+template bool msSolver::isSolvable<FrenchShape>(const msBoard&);
+template bool msSolver::isSolvable<EnglishShape>(const msEnglishBoard&);
+template bool msSolver::isSolvable<WieglebShape>(const msWieglebBoard&);
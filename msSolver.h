@@ -1,4 +1,3 @@
-
 /*
 *     msSolver.h
 *     By: Brendan Roy
@@ -15,21 +14,103 @@
 #define MSSOLVER_H_
 
 #include "msBoard.h"
+#include <cstdint>
+#include <ostream>
 #include <vector>
 
 #include "configuration.h"
 
 namespace msSolver {
 
-    std::vector<msBoard::Move> solve(const msBoard& start);
+    /*
+      Which visited set solve uses. AUTO picks one for every solve from the
+      memory available and the start board's size (see chooseBackend in 
+      msSolver.cpp) - the others force one, e.g. to compare them
+    */
+    enum class Backend { AUTO, BITMAP, QUOTIENT_SET, HASH_SET };
+
+    /************ SolverStats *********
+     Everything we measure about a single solve. Only the final visited-set
+     size, load factor and recent filter hits are always filled in - the 
+     per-node counters are only collected when COLLECT_SOLVER_STATS is set in
+     configuration.h, and cost nothing otherwise
+
+    Members:
+        nodesExpanded     - boards taken off the stack and played a move on
+        seenProbes        - calls to the visited set's testAndSet (one per
+                            expanded child, unless the child has no more 
+                            than memoFloor marbles)
+        sleepSkips        - moves not played because they were in a sleep
+                            set (see ENABLE_SLEEP_SETS)
+        deadPrunes        - new boards dropped because they had 2 or more 
+                            dead marbles (see ENABLE_DEAD_MARBLE_PRUNING)
+        mersonPrunes      - new boards dropped because an empty Merson region
+                            split their marbles (see ENABLE_MERSON_PRUNING)
+        symmetricNodes    - boards with a symmetry of their own, whose moves
+                            were cut to one per orbit (see 
+                            ENABLE_STABILIZER_PRUNING)
+        seenHits[d]       - children at depth d that were already visited
+        seenMisses[d]     - children at depth d that were new
+        maxStackDepth     - the deepest the dfs stack got
+        nodesByMarbles[n] - new boards with n marbles that generated moves
+        movesByMarbles[n] - total moves generated from boards with n marbles
+                            (movesByMarbles / nodesByMarbles = branching)
+        canonicalCycles   - cycles spent in getCanonicalBits
+        moveGenCycles     - cycles spent in validMoves
+        seenCycles        - cycles spent in the visited set's testAndSet
+        seenSize          - number of boards in the visited set at the end
+        seenLoadFactor    - how full the visited set's storage was at the end
+        recentHits        - visited-set hits answered by its recent filter 
+                            without touching the backend (see 
+                            RECENT_FILTER_LOG2)
+        memoFloor         - boards with this many marbles or fewer were not
+                            put in the visited set by the end (see 
+                            MEMO_MIN_MARBLES and ADAPTIVE_MEMO)
+        backend           - the visited set this solve used
+    *********************************/
+    struct SolverStats {
+        static constexpr int MAX_DEPTH = 64;
+
+        uint64_t nodesExpanded = 0;
+        uint64_t seenProbes = 0;
+        uint64_t sleepSkips = 0;
+        uint64_t deadPrunes = 0;
+        uint64_t mersonPrunes = 0;
+        uint64_t symmetricNodes = 0;
+        uint64_t seenHits[MAX_DEPTH + 1] = {};
+        uint64_t seenMisses[MAX_DEPTH + 1] = {};
+        int      maxStackDepth = 0;
+        uint64_t nodesByMarbles[MAX_DEPTH + 1] = {};
+        uint64_t movesByMarbles[MAX_DEPTH + 1] = {};
+
+        uint64_t canonicalCycles = 0;
+        uint64_t moveGenCycles = 0;
+        uint64_t seenCycles = 0;
+
+        uint64_t seenSize = 0;
+        double   seenLoadFactor = 0.0;
+        uint64_t recentHits = 0;
+        int      memoFloor = 0;
+        Backend  backend = Backend::AUTO;
+
+        void print(std::ostream &stream) const;
+    };
+
+    /*
+      Both are templates on the board's Shape - they are explicitly 
+      instantiated for every shape in msSolver.cpp, so calls just deduce it
+    */
+    template <typename Shape>
+    std::vector<typename msBasicBoard<Shape>::Move> 
+                    solve(const msBasicBoard<Shape>& start, 
+                          SolverStats *stats = nullptr);
 
-    bool isSolvable(const msBoard& start);
+    template <typename Shape>
+    bool isSolvable(const msBasicBoard<Shape>& start);
 
-    // #if HAVE_16GB_RAM
-    // msBitmap<msBoard, decltype(&msBoard::boardToBits)> bitmap(BIT_COUNT, &msBoard::boardToBits);
-    // #else 
-    // robin_hood::unordered_flat_set<uint64_t> seen;
-    // #endif
+    void setBackend(Backend backend);
+    bool parseBackend(const char *name, Backend &backend);
+    const char *backendName(Backend backend);
 };
 
 #endif
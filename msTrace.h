@@ -0,0 +1,103 @@
+/*
+    msTrace.h
+    Marble Solitaire
+
+    Compile-time phase tracing for the solver's hot loop. Every TRACE_SCOPE
+    reads the cycle counter when it is entered and when it goes out of scope
+    and adds the difference to its phase's total. When the program exits, a
+    breakdown of calls, cycles and share of traced time per phase is printed to
+    stderr - the same breakdown a profiler would give, without needing one.
+
+    Tracing is only compiled in when ENABLE_PHASE_TRACE is set in
+    configuration.h. Each scope costs two cycle counter reads, which is a
+    large fraction of the cheapest phases - compare phases with each other
+    rather than with untraced solve times.
+*/
+
+#ifndef MSTRACE_H_
+#define MSTRACE_H_
+
+#include "configuration.h"
+
+#if ENABLE_PHASE_TRACE
+    #include "msCycles.h"
+
+    #include <cstdint>
+    #include <cstdio>
+#endif
+
+namespace msTrace {
+
+    enum Phase { APPLY_MOVE = 0, CANONICAL, TEST_AND_SET, VALID_MOVES,
+                 SYMMETRY_FILTER, DEAD_MARBLES, STACK_PUSH, STACK_POP, 
+                 NUM_PHASES
+    };
+
+#if ENABLE_PHASE_TRACE
+
+    /************ Totals *********
+     The accumulated calls and cycles of every phase. There is exactly one
+     instance (TOTALS below) and its destructor prints the breakdown
+
+    Members:
+        uint64_t calls[NUM_PHASES]  - how many times each phase was entered
+        uint64_t cycles[NUM_PHASES] - total cycles spent inside each phase
+    *********************************/
+    struct Totals {
+        uint64_t calls[NUM_PHASES] = {};
+        uint64_t cycles[NUM_PHASES] = {};
+
+        ~Totals()
+        {
+            static const char *const NAMES[NUM_PHASES] = {
+                "applyMove", "getCanonicalBits", "testAndSet", "validMoves",
+                "symmetry filter", "numDeadMarbles", "stack push", "stack pop"
+            };
+            uint64_t total = 0;
+            for (int p = 0; p < NUM_PHASES; p++) total += cycles[p];
+            if (total == 0) return;
+
+            std::fprintf(stderr, "\n%-18s %14s %16s %12s %8s\n", "phase", 
+                         "calls", "cycles", "cycles/call", "share");
+            for (int p = 0; p < NUM_PHASES; p++) {
+                std::fprintf(stderr, "%-18s %14llu %16llu %12.1f %7.1f%%\n",
+                             NAMES[p], (unsigned long long) calls[p],
+                             (unsigned long long) cycles[p],
+                             calls[p] ? double(cycles[p]) / calls[p] : 0.0,
+                             100.0 * cycles[p] / total);
+            }
+        }
+    };
+
+    inline Totals TOTALS;
+
+    /************ Scope *********
+     Adds the cycles between its construction and destruction to a phase
+    *********************************/
+    class Scope {
+      public:
+        explicit Scope(Phase p) : phase(p), start(readCycles()) {}
+        ~Scope()
+        {
+            TOTALS.cycles[phase] += readCycles() - start;
+            TOTALS.calls[phase]++;
+        }
+        Scope(const Scope&) = delete;
+        Scope &operator=(const Scope&) = delete;
+
+      private:
+        Phase phase;
+        uint64_t start;
+    };
+
+    #define TRACE_SCOPE(phase) msTrace::Scope traceScope_(msTrace::phase)
+
+#else
+
+    #define TRACE_SCOPE(phase)
+
+#endif
+
+}
+
+#endif